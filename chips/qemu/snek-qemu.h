@@ -19,6 +19,11 @@
 #define RX_LINEBUF	132
 #define SNEK_POOL	(32 * 1024)
 
+#define SNEK_EXEC_THREADED
+#define SNEK_QUICKEN
+#define SNEK_FUSE
+#define SNEK_LINE_TABLE
+
 extern int snek_qemu_getc(void);
 
 #define abort() exit(1)
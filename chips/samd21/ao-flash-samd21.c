@@ -220,6 +220,13 @@ ao_flash_read_byte(void)
 	return __flash8__[flash_read_offset++];
 }
 
+const void *
+ao_flash_read_addr(uint32_t *size)
+{
+	*size = ao_flash_size();
+	return __flash8__;
+}
+
 static uint32_t
 ao_flash_first_erased(void)
 {
@@ -34,6 +34,9 @@ ao_flash_read_init(void);
 uint8_t
 ao_flash_read_byte(void);
 
+const void *
+ao_flash_read_addr(uint32_t *size);
+
 void
 ao_flash_erase_all(void);
 
@@ -22,6 +22,8 @@
 #define SNEK_GETC()		getc(stdin)
 #define SNEK_POOL		(16 * 1024)
 
+#define SNEK_EXEC_THREADED
+
 #define SNEK_IO_GETC(file)	ao_usb_getc()
 #define SNEK_IO_WAITING(file)	ao_usb_waiting()
 
@@ -75,6 +75,15 @@ snek_builtin_eeprom_erase(void)
 void
 snek_eeprom_load(void)
 {
+#ifdef SNEK_IMAGE
+	/* A compiled image is loaded straight from flash */
+	uint32_t size;
+	const void *image = ao_flash_read_addr(&size);
+	if (snek_image_load(image, size)) {
+		snek_image_run();
+		return;
+	}
+#endif
 	snek_interactive = false;
 	ao_flash_read_init();
 	save_getc = __iob[0]->get;
@@ -364,8 +364,8 @@ snek_ev3_init_colors(void)
 {
 	for (unsigned long i = 1; i < COLORS_NUM; i++) {
 		size_t len = strlen(COLORS[i]);
-		char * p = snek_alloc(len + 1);
-		memcpy(p, COLORS[i], len + 1);
+		char * p = snek_string_alloc(len);
+		memcpy(p, COLORS[i], len);
 		colors_stack_pos[i] = snek_stackp;
 		snek_stack_push_string(p);
 	}
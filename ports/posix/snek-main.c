@@ -17,12 +17,22 @@
 #include <readline/readline.h>
 #include <readline/history.h>
 #include <signal.h>
+#ifdef SNEK_ROM
+#include <sys/mman.h>
+#endif
 
 FILE	*snek_posix_input;
 
 static const struct option options[] = {
 	{ .name = "version", .has_arg = 0, .val = 'v' },
 	{ .name = "interactive", .has_arg = 0, .val = 'i' },
+#ifdef SNEK_DYNAMIC
+	{ .name = "heap-max", .has_arg = 1, .val = 'm' },
+#endif
+#ifdef SNEK_IMAGE
+	{ .name = "compile", .has_arg = 1, .val = 'c' },
+#endif
+	{ .name = "profile", .has_arg = 1, .val = 'p' },
 	{ .name = "help", .has_arg = 0, .val = '?' },
 	{ .name = NULL, .has_arg = 0, .val = 0 },
 };
@@ -30,7 +40,7 @@ static const struct option options[] = {
 static void
 usage (char *program, int val)
 {
-	fprintf(stderr, "usage: %s [--version] [--help] [--interactive] <program.py>\n", program);
+	fprintf(stderr, "usage: %s [--version] [--help] [--interactive] [--heap-max <size>] [--compile <image>] [--profile <stacks>] <program.py>\n", program);
 	exit(val);
 }
 
@@ -60,6 +70,108 @@ snek_getc_interactive(void)
 	return c;
 }
 
+#ifdef SNEK_DYNAMIC
+static uint32_t
+snek_parse_size(char *program, const char *arg)
+{
+	char		*end;
+	unsigned long	size = strtoul(arg, &end, 0);
+
+	switch (*end) {
+	case 'k':
+	case 'K':
+		size *= 1024;
+		end++;
+		break;
+	case 'm':
+	case 'M':
+		size *= 1024 * 1024;
+		end++;
+		break;
+	}
+	if (end == arg || *end != '\0')
+		usage(program, 1);
+	if (size > SNEK_POOL_MAX)
+		size = SNEK_POOL_MAX;
+	return size;
+}
+#endif
+
+#ifdef SNEK_IMAGE
+/*
+ * Save the program compiled from the input file as an image
+ */
+static bool
+snek_image_write(const char *name)
+{
+	snek_image_t	image;
+	FILE		*output;
+	bool		ret;
+
+	if (!snek_image_save(&image)) {
+		fprintf(stderr, "%s: cannot save image\n", name);
+		return false;
+	}
+	output = fopen(name, "wb");
+	if (!output) {
+		perror(name);
+		return false;
+	}
+	ret = (fwrite(&image, sizeof (image), 1, output) == 1 &&
+#ifdef SNEK_ROM
+	       fwrite(snek_rom, 1, image.rom, output) == image.rom &&
+#endif
+	       fwrite(snek_pool, 1, image.top, output) == image.top);
+	if (fclose(output) != 0)
+		ret = false;
+	if (!ret)
+		perror(name);
+	return ret;
+}
+
+/*
+ * Files starting with the image magic number are loaded and run
+ * directly instead of being parsed
+ */
+static bool
+snek_image_read(FILE *input, bool *ret)
+{
+	uint32_t	magic;
+	long		size;
+	void		*data;
+
+	if (fread(&magic, sizeof (magic), 1, input) != 1 || magic != SNEK_IMAGE_MAGIC) {
+		rewind(input);
+		return false;
+	}
+	if (fseek(input, 0, SEEK_END) != 0 || (size = ftell(input)) < 0) {
+		perror(snek_file);
+		exit(1);
+	}
+	rewind(input);
+#ifdef SNEK_ROM
+	/* Code and strings run from the image, so map it read-only */
+	data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fileno(input), 0);
+	if (data == MAP_FAILED) {
+#else
+	data = malloc(size);
+	if (!data || fread(data, 1, size, input) != (size_t) size) {
+#endif
+		perror(snek_file);
+		exit(1);
+	}
+	if (!snek_image_load(data, size)) {
+		fprintf(stderr, "%s: invalid image\n", snek_file);
+		exit(1);
+	}
+#ifndef SNEK_ROM
+	free(data);
+#endif
+	*ret = snek_image_run();
+	return true;
+}
+#endif
+
 static bool snek_sigint;
 
 int
@@ -94,8 +206,12 @@ main (int argc, char **argv)
 	int c;
 	bool do_interactive = true;
 	bool interactive_flag = false;
+#ifdef SNEK_IMAGE
+	char *image_file = NULL;
+#endif
+	char *profile_file = NULL;
 
-	while ((c = getopt_long(argc, argv, "v?i", options, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "v?im:c:p:", options, NULL)) != -1) {
 		switch (c) {
 		case 'v':
 			printf("%s version %s\n", argv[0], SNEK_VERSION);
@@ -104,6 +220,19 @@ main (int argc, char **argv)
 		case 'i':
 			interactive_flag = true;
 			break;
+#ifdef SNEK_DYNAMIC
+		case 'm':
+			snek_pool_max = snek_parse_size(argv[0], optarg);
+			break;
+#endif
+#ifdef SNEK_IMAGE
+		case 'c':
+			image_file = optarg;
+			break;
+#endif
+		case 'p':
+			profile_file = optarg;
+			break;
 		case '?':
 			usage(argv[0], 0);
 			break;
@@ -115,8 +244,20 @@ main (int argc, char **argv)
 
 	signal(SIGINT, sigint);
 
+#ifdef SNEK_DYNAMIC
+	if (!snek_mem_alloc(SNEK_POOL)) {
+		fprintf(stderr, "%s: cannot allocate heap\n", argv[0]);
+		exit(1);
+	}
+#endif
+
 	snek_init();
 
+	if (profile_file && !snek_profile_start(profile_file)) {
+		fprintf(stderr, "%s: cannot start profiler\n", argv[0]);
+		exit(1);
+	}
+
 	bool ret = true;
 
 	if (argv[optind]) {
@@ -126,12 +267,27 @@ main (int argc, char **argv)
 			perror(snek_file);
 			exit(1);
 		}
+#ifdef SNEK_IMAGE
+		snek_image_build = image_file != NULL;
+		if (snek_image_build || !snek_image_read(snek_posix_input, &ret))
+#endif
 		if (snek_parse() != snek_parse_success)
 			ret = false;
 		fclose(snek_posix_input);
 		do_interactive = interactive_flag;
 	}
 
+#ifdef SNEK_IMAGE
+	if (image_file) {
+		if (!argv[optind])
+			usage(argv[0], 1);
+		snek_image_build = false;
+		if (ret && !snek_image_write(image_file))
+			ret = false;
+		return ret ? 0 : 1;
+	}
+#endif
+
 	if (do_interactive) {
 		printf("Welcome to Snek version %s\n", SNEK_VERSION);
 		snek_file = "<stdin>";
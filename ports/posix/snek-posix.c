@@ -51,6 +51,15 @@ snek_builtin_time_sleep(snek_poly_t a)
 	return SNEK_NULL;
 }
 
+uint32_t
+snek_posix_usec(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (uint32_t) t.tv_sec * 1000000 + (uint32_t) (t.tv_nsec / 1000);
+}
+
 snek_poly_t
 snek_builtin_time_monotonic(void)
 {
@@ -63,6 +72,15 @@ snek_builtin_time_monotonic(void)
 	return snek_float_to_poly((float) (t.tv_sec - start_sec) + (float) t.tv_nsec / 1e9f);
 }
 
+#ifndef SNEK_GC_STATS
+/* Without the collector statistics, there is nothing to report */
+snek_poly_t
+snek_builtin_gc_stats(void)
+{
+	return snek_list_imm(0, snek_list_dict);
+}
+#endif
+
 snek_poly_t
 snek_builtin_random_seed(snek_poly_t a)
 {
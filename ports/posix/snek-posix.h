@@ -19,6 +19,22 @@ extern FILE	*snek_posix_input;
 
 int snek_getc(FILE *input);
 
+uint32_t snek_posix_usec(void);
+
+bool snek_profile_start(const char *file);
+
+/* Let the profiler know when objects may be moving */
+extern volatile int snek_profile_collecting;
+
+#define SNEK_COLLECT_HOOK_START	do {				\
+		snek_profile_collecting++;			\
+		__atomic_signal_fence(__ATOMIC_SEQ_CST);	\
+	} while (0)
+#define SNEK_COLLECT_HOOK_STOP	do {				\
+		__atomic_signal_fence(__ATOMIC_SEQ_CST);	\
+		snek_profile_collecting--;			\
+	} while (0)
+
 #ifdef __APPLE__
 #define isnanf isnan
 #endif
@@ -27,4 +43,42 @@ int snek_getc(FILE *input);
 
 #define SNEK_DEBUG	1
 
+#define SNEK_ID_CACHE	256
+
+#define SNEK_GLOBALS_HASH
+
+#define SNEK_DICT_HASH
+
+#define SNEK_STRING_LEN
+
+#define SNEK_STRING_CHARS
+
+#define SNEK_STRING_BUILDER
+
+#define SNEK_LOCAL_SLOTS
+
+#define SNEK_NAME_HASH
+
+#define SNEK_GENERATIONAL	64
+
+#define SNEK_INCREMENTAL_MARK	16
+
+#define SNEK_CHUNK_BORROW
+
+#define SNEK_FREE_LIST	64
+
+#define SNEK_DYNAMIC
+
+#define SNEK_GC_STATS
+#define SNEK_GC_TIME()	snek_posix_usec()
+
+#define SNEK_EXEC_THREADED
+#define SNEK_QUICKEN
+#define SNEK_FUSE
+#define SNEK_LINE_TABLE
+#define SNEK_FOLD
+
+#define SNEK_IMAGE
+#define SNEK_ROM
+
 #endif /* _SNEK_POSIX_H_ */
@@ -0,0 +1,386 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ */
+
+#include "snek.h"
+#include <signal.h>
+#include <sys/time.h>
+
+/*
+ * Sampling profiler. A SIGPROF timer interrupts the interpreter
+ * every millisecond of CPU time. The handler looks at the running
+ * code and ip, then walks the frame chain to find each caller,
+ * reducing every level to a pair of line numbers: the first line
+ * of the function and the line running in it. Those stacks are
+ * counted in a table allocated before the timer starts, so the
+ * handler never allocates or touches stdio. Names are only
+ * attached at exit, by looking for functions in the global
+ * frame.
+ */
+
+#define SNEK_PROFILE_USEC	1000
+#define SNEK_PROFILE_DEPTH	32
+#define SNEK_PROFILE_STACKS	4096	/* must be a power of two */
+
+/* Values for 'func' which aren't line numbers */
+#define SNEK_PROFILE_TOP	0		/* top-level statements */
+#define SNEK_PROFILE_IDLE	0xffffffffu	/* not running code */
+#define SNEK_PROFILE_COLLECT	0xfffffffeu	/* collecting garbage */
+
+typedef struct snek_profile_frame {
+	uint32_t	func;
+	uint32_t	line;
+} snek_profile_frame_t;
+
+typedef struct snek_profile_stack {
+	uint32_t		count;
+	uint32_t		depth;
+	snek_profile_frame_t	frames[SNEK_PROFILE_DEPTH];	/* innermost first */
+} snek_profile_stack_t;
+
+volatile int			snek_profile_collecting;
+
+static snek_profile_stack_t	*snek_profile_stacks;
+static uint32_t			snek_profile_samples;
+static uint32_t			snek_profile_dropped;
+static const char		*snek_profile_file;
+
+/*
+ * Return 'addr' as code if it lies within the heap or the image,
+ * so that a sample taken at a bad moment can't read elsewhere
+ */
+static snek_code_t *
+snek_profile_code(const void *addr)
+{
+	const uint8_t	*a = addr;
+	snek_code_t	*code = (snek_code_t *) a;
+	uint32_t	size;
+
+#ifdef SNEK_ROM
+	if (snek_is_rom_addr(a))
+		size = snek_rom_size - (a - snek_rom);
+	else
+#endif
+	if (snek_pool <= a && a < snek_pool + SNEK_POOL_SIZE)
+		size = SNEK_POOL_SIZE - (a - snek_pool);
+	else
+		return NULL;
+	if (size < sizeof (snek_code_t))
+		return NULL;
+#ifdef SNEK_LINE_TABLE
+	if (size - sizeof (snek_code_t) < (uint32_t) code->size + code->lines)
+		return NULL;
+#else
+	if (size - sizeof (snek_code_t) < code->size)
+		return NULL;
+#endif
+	return code;
+}
+
+static snek_frame_t *
+snek_profile_frame(snek_offset_t offset)
+{
+	if (snek_offset_is_none(offset) || offset >= SNEK_POOL_SIZE - sizeof (snek_frame_t))
+		return NULL;
+	return snek_pool_addr(offset);
+}
+
+/*
+ * Find the line holding the instruction at 'ip'
+ */
+static uint32_t
+snek_profile_line(snek_code_t *code, snek_offset_t ip)
+{
+#ifdef SNEK_LINE_TABLE
+	return snek_code_line_at(code, ip);
+#else
+	snek_offset_t	i;
+	snek_offset_t	line = 0;
+	snek_op_t	op;
+
+	for (i = 0; i < ip && i < code->size; i += 1 + snek_op_operand_size(op)) {
+		op = code->code[i] & ~snek_op_push;
+		if (op == snek_op_line)
+			memcpy(&line, &code->code[i + 1], sizeof (snek_offset_t));
+	}
+	return line;
+#endif
+}
+
+static void
+snek_profile_record(const snek_profile_frame_t *frames, uint32_t depth)
+{
+	uint32_t	hash = depth;
+	uint32_t	d;
+	uint32_t	probe;
+
+	for (d = 0; d < depth; d++)
+		hash = (hash * 31 + frames[d].func) * 31 + frames[d].line;
+
+	snek_profile_samples++;
+	for (probe = 0; probe < SNEK_PROFILE_STACKS; probe++) {
+		snek_profile_stack_t *s = &snek_profile_stacks[(hash + probe) & (SNEK_PROFILE_STACKS - 1)];
+
+		if (s->count == 0) {
+			s->depth = depth;
+			memcpy(s->frames, frames, depth * sizeof (snek_profile_frame_t));
+		} else if (s->depth != depth ||
+			   memcmp(s->frames, frames, depth * sizeof (snek_profile_frame_t)) != 0)
+			continue;
+		s->count++;
+		return;
+	}
+	snek_profile_dropped++;
+}
+
+static void
+snek_profile_sample(int sig)
+{
+	snek_profile_frame_t	frames[SNEK_PROFILE_DEPTH];
+	uint32_t		depth = 0;
+	snek_code_t		*code;
+	snek_frame_t		*frame = snek_frame;
+	snek_offset_t		ip;
+
+	(void) sig;
+	if (snek_profile_collecting) {
+		frames[depth++] = (snek_profile_frame_t) { .func = SNEK_PROFILE_COLLECT };
+	} else if (!snek_code) {
+		frames[depth++] = (snek_profile_frame_t) { .func = SNEK_PROFILE_IDLE };
+	} else if ((code = snek_profile_code(snek_code))) {
+#ifdef SNEK_LINE_TABLE
+		ip = snek_exec_ip;
+		frames[depth].line = snek_profile_line(code, ip);
+#else
+		frames[depth].line = snek_line;
+#endif
+		for (;;) {
+			frames[depth].func = frame ? snek_code_line(code) : SNEK_PROFILE_TOP;
+			depth++;
+			if (!frame || depth == SNEK_PROFILE_DEPTH)
+				break;
+
+			/* The frame holds the caller's code and return address */
+			code = snek_profile_code(snek_pool_addr(frame->code));
+			if (!code)
+				break;
+			ip = frame->ip;
+			frames[depth].line = snek_profile_line(code, ip ? ip - 1 : 0);
+			frame = snek_profile_frame(frame->prev);
+		}
+	}
+	snek_profile_record(frames, depth);
+}
+
+/*
+ * Functions are named by finding them in the global frame
+ */
+static const char *
+snek_profile_name(uint32_t func, char *buf, size_t len)
+{
+	snek_offset_t	i;
+
+	switch (func) {
+	case SNEK_PROFILE_TOP:
+		return "<module>";
+	case SNEK_PROFILE_IDLE:
+		return "[idle]";
+	case SNEK_PROFILE_COLLECT:
+		return "[collect]";
+	}
+	for (i = 0; snek_globals && i < snek_globals->nvariables; i++) {
+		snek_poly_t value = snek_globals->variables[i].value;
+
+		if (snek_poly_type(value) == snek_func) {
+			snek_func_t *f = snek_poly_to_func(value);
+
+			if (snek_code_line(snek_pool_addr(f->code)) == func)
+				return snek_name_string(snek_globals->variables[i].id);
+		}
+	}
+	snprintf(buf, len, "<line %u>", func);
+	return buf;
+}
+
+static void
+snek_profile_print_frame(FILE *f, const snek_profile_frame_t *frame)
+{
+	char	buf[32];
+
+	fprintf(f, "%s", snek_profile_name(frame->func, buf, sizeof (buf)));
+	if (frame->func < SNEK_PROFILE_COLLECT)
+		fprintf(f, " (%s:%u)", snek_file, frame->line);
+}
+
+/* Totals for one function or one line in the flat profile */
+typedef struct snek_profile_count {
+	snek_profile_frame_t	frame;
+	uint32_t		self;
+	uint32_t		total;
+} snek_profile_count_t;
+
+static int
+snek_profile_count_cmp(const void *a, const void *b)
+{
+	const snek_profile_count_t *ca = a, *cb = b;
+
+	if (ca->self != cb->self)
+		return ca->self < cb->self ? 1 : -1;
+	if (ca->total != cb->total)
+		return ca->total < cb->total ? 1 : -1;
+	return 0;
+}
+
+static snek_profile_count_t *
+snek_profile_count(snek_profile_count_t *counts, uint32_t *ncount, snek_profile_frame_t frame)
+{
+	uint32_t	c;
+
+	for (c = 0; c < *ncount; c++)
+		if (counts[c].frame.func == frame.func && counts[c].frame.line == frame.line)
+			return &counts[c];
+	counts[c] = (snek_profile_count_t) { .frame = frame };
+	(*ncount)++;
+	return &counts[c];
+}
+
+static void
+snek_profile_flat(FILE *f)
+{
+	uint32_t		max = SNEK_PROFILE_STACKS * SNEK_PROFILE_DEPTH;
+	snek_profile_count_t	*funcs = calloc(max, sizeof (snek_profile_count_t));
+	snek_profile_count_t	*lines = calloc(max, sizeof (snek_profile_count_t));
+	uint32_t		nfunc = 0, nline = 0;
+	uint32_t		i, d, e;
+	char			buf[32];
+
+	if (!funcs || !lines) {
+		free(funcs);
+		free(lines);
+		return;
+	}
+	for (i = 0; i < SNEK_PROFILE_STACKS; i++) {
+		snek_profile_stack_t *s = &snek_profile_stacks[i];
+
+		if (!s->count)
+			continue;
+		snek_profile_count(lines, &nline, s->frames[0])->self += s->count;
+		for (d = 0; d < s->depth; d++) {
+			snek_profile_frame_t func = { .func = s->frames[d].func };
+			snek_profile_count_t *c = snek_profile_count(funcs, &nfunc, func);
+
+			if (d == 0)
+				c->self += s->count;
+
+			/* Recursive calls only count once toward the total */
+			for (e = 0; e < d; e++)
+				if (s->frames[e].func == func.func)
+					break;
+			if (e == d)
+				c->total += s->count;
+		}
+	}
+	qsort(funcs, nfunc, sizeof (snek_profile_count_t), snek_profile_count_cmp);
+	qsort(lines, nline, sizeof (snek_profile_count_t), snek_profile_count_cmp);
+
+	fprintf(f, "%u samples", snek_profile_samples);
+	if (snek_profile_dropped)
+		fprintf(f, ", %u dropped", snek_profile_dropped);
+	fprintf(f, "\n\n   self   total  function\n");
+	for (i = 0; i < nfunc; i++) {
+		fprintf(f, "%6.1f%% %6.1f%%  %s", 100.0 * funcs[i].self / snek_profile_samples,
+			100.0 * funcs[i].total / snek_profile_samples,
+			snek_profile_name(funcs[i].frame.func, buf, sizeof (buf)));
+		if (funcs[i].frame.func < SNEK_PROFILE_COLLECT && funcs[i].frame.func != SNEK_PROFILE_TOP)
+			fprintf(f, " (%s:%u)", snek_file, funcs[i].frame.func);
+		fprintf(f, "\n");
+	}
+	fprintf(f, "\n   self  line\n");
+	for (i = 0; i < nline; i++) {
+		fprintf(f, "%6.1f%%  ", 100.0 * lines[i].self / snek_profile_samples);
+		snek_profile_print_frame(f, &lines[i].frame);
+		fprintf(f, "\n");
+	}
+	free(funcs);
+	free(lines);
+}
+
+/*
+ * Write each stack, outermost call first, in the collapsed format
+ * read by flame graph tools
+ */
+static bool
+snek_profile_collapsed(FILE *f)
+{
+	uint32_t	i, d;
+
+	for (i = 0; i < SNEK_PROFILE_STACKS; i++) {
+		snek_profile_stack_t *s = &snek_profile_stacks[i];
+
+		if (!s->count)
+			continue;
+		for (d = s->depth; d--;) {
+			snek_profile_print_frame(f, &s->frames[d]);
+			if (d)
+				putc(';', f);
+		}
+		fprintf(f, " %u\n", s->count);
+	}
+	return !ferror(f);
+}
+
+static void
+snek_profile_stop(void)
+{
+	struct itimerval	timer = { 0 };
+	FILE			*f;
+
+	setitimer(ITIMER_PROF, &timer, NULL);
+	signal(SIGPROF, SIG_IGN);
+	if (!snek_profile_samples)
+		return;
+
+	fflush(stdout);
+	snek_profile_flat(stderr);
+
+	f = fopen(snek_profile_file, "w");
+	if (!f || !snek_profile_collapsed(f))
+		perror(snek_profile_file);
+	if (f && fclose(f) != 0)
+		perror(snek_profile_file);
+}
+
+/*
+ * Start sampling. The flat profile is printed to stderr and the
+ * stacks written to 'file' when snek exits
+ */
+bool
+snek_profile_start(const char *file)
+{
+	struct sigaction	action = { .sa_handler = snek_profile_sample, .sa_flags = SA_RESTART };
+	struct itimerval	timer = {
+		.it_interval = { .tv_usec = SNEK_PROFILE_USEC },
+		.it_value = { .tv_usec = SNEK_PROFILE_USEC },
+	};
+
+	snek_profile_stacks = calloc(SNEK_PROFILE_STACKS, sizeof (snek_profile_stack_t));
+	if (!snek_profile_stacks)
+		return false;
+	snek_profile_file = file;
+	sigemptyset(&action.sa_mask);
+	if (sigaction(SIGPROF, &action, NULL) != 0 ||
+	    atexit(snek_profile_stop) != 0 ||
+	    setitimer(ITIMER_PROF, &timer, NULL) != 0)
+		return false;
+	return true;
+}
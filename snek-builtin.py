@@ -216,6 +216,79 @@ def dump_names(fp):
     fprint("#define SNEK_BUILTIN_NAMES_SIZE %d" % total, file=fp)
 
 
+def name_hash(name):
+    h = 2166136261
+    for c in name.encode("utf-8"):
+        h = ((h ^ c) * 16777619) & 0xFFFFFFFF
+    return h
+
+
+def hash_slot(h, disp, size):
+    return ((((h ^ (disp * 0x9E3779B9)) * 0x85EBCA6B) & 0xFFFFFFFF) >> 16) % size
+
+
+def dump_hash(fp):
+    """Emit a hash-and-displace perfect hash over the builtin names,
+    along with the offset of each name within snek_builtin_names.
+    Conditional builtins move names around at compile time, so
+    skip the tables in that case and let snek-name.c fall back to
+    a linear search."""
+    names = sorted(builtins)
+    for name in names:
+        if name.condition:
+            return
+    nbucket = max(1, len(names) // 2)
+    size = len(names) + len(names) // 4 + 1
+    while True:
+        buckets = [[] for b in range(nbucket)]
+        for e, name in enumerate(names):
+            h = name_hash(name.name)
+            buckets[h % nbucket] += [(e + 1, h)]
+        disp = [0] * nbucket
+        table = [0] * size
+        ok = True
+        for b in sorted(range(nbucket), key=lambda b: -len(buckets[b])):
+            if not buckets[b]:
+                continue
+            for d in range(256):
+                slots = [hash_slot(h, d, size) for e, h in buckets[b]]
+                if len(set(slots)) == len(slots) and all(
+                    table[slot] == 0 for slot in slots
+                ):
+                    break
+            else:
+                ok = False
+                break
+            disp[b] = d
+            for (e, h), slot in zip(buckets[b], slots):
+                table[slot] = e
+        if ok:
+            break
+        size += 1
+
+    entry_type = "uint8_t" if len(names) < 256 else "uint16_t"
+    fprint("#ifdef SNEK_NAME_HASH", file=fp)
+    fprint("#define SNEK_BUILTIN_HASH_BUCKETS %d" % nbucket, file=fp)
+    fprint("#define SNEK_BUILTIN_HASH_SIZE %d" % size, file=fp)
+    fprint("static const uint8_t snek_builtin_hash_disp[] = {", file=fp)
+    for b in range(0, nbucket, 16):
+        fprint("\t%s," % ", ".join("%d" % d for d in disp[b : b + 16]), file=fp)
+    fprint("};", file=fp)
+    fprint("static const %s snek_builtin_hash[] = {" % entry_type, file=fp)
+    for t in range(0, size, 16):
+        fprint("\t%s," % ", ".join("%d" % e for e in table[t : t + 16]), file=fp)
+    fprint("};", file=fp)
+    fprint("static const uint16_t snek_builtin_names_offset[] = {", file=fp)
+    offset = 0
+    for name in names:
+        if name.keyword:
+            offset += 1
+        fprint("\t%d,\t/* %s */" % (offset, name.name), file=fp)
+        offset += len(name.name) + 1
+    fprint("};", file=fp)
+    fprint("#endif", file=fp)
+
+
 def trim_mu(n):
     if n.find(".") >= 0:
         return n[: n.find(".")]
@@ -336,6 +409,8 @@ def builtin_main():
 
     dump_names(fp)
 
+    dump_hash(fp)
+
     fprint(file=fp)
 
     max_formals = max_args()
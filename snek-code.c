@@ -34,7 +34,7 @@ snek_offset_t		snek_compile_prev_prev;		/* offset of instruction before previous
 /*
  * Compute the size of all operands for an opcode
  */
-static uint8_t
+uint8_t
 snek_op_operand_size(snek_op_t op)
 {
 	switch (op) {
@@ -45,9 +45,17 @@ snek_op_operand_size(snek_op_t op)
 	case snek_op_string:
 	case snek_op_list:
 	case snek_op_tuple:
+#ifndef SNEK_NO_DICT
+	case snek_op_dict:
+#endif
 		return sizeof (snek_offset_t);
 	case snek_op_id:
+#ifdef SNEK_LOCAL_SLOTS
+	case snek_op_local:
+	case snek_op_assign_local:
+#endif
 	case snek_op_global:
+	case snek_op_del:
 	case snek_op_assign:
 	case snek_op_assign_named:
 	case snek_op_assign_plus:
@@ -67,6 +75,24 @@ snek_op_operand_size(snek_op_t op)
 		return sizeof (snek_offset_t);
 	case snek_op_slice:
 		return 1;
+#ifdef SNEK_FUSE
+	case snek_op_plus_i:
+	case snek_op_minus_i:
+	case snek_op_times_i:
+	case snek_op_eq_i:
+	case snek_op_ne_i:
+	case snek_op_gt_i:
+	case snek_op_lt_i:
+	case snek_op_ge_i:
+	case snek_op_le_i:
+		return sizeof (int8_t);
+	case snek_op_eq_branch_false:
+	case snek_op_ne_branch_false:
+	case snek_op_gt_branch_false:
+	case snek_op_lt_branch_false:
+	case snek_op_ge_branch_false:
+	case snek_op_le_branch_false:
+#endif
 	case snek_op_chain_eq:
 	case snek_op_chain_ne:
 	case snek_op_chain_gt:
@@ -76,6 +102,7 @@ snek_op_operand_size(snek_op_t op)
 	case snek_op_branch:
 	case snek_op_branch_true:
 	case snek_op_branch_false:
+	case snek_op_range_break:
 	case snek_op_forward:
 	case snek_op_line:
 		return sizeof (snek_offset_t);
@@ -181,9 +208,19 @@ snek_code_add_string(char *string)
 {
 	snek_offset_t s;
 
+#ifdef SNEK_ROM
+	if (snek_image_build) {
+		snek_offset_t size = SNEK_STRING_TEXT + snek_string_len(string) + 1;
+		char *rom = snek_rom_alloc(size);
+		if (!rom)
+			return;
+		memcpy(rom, string - SNEK_STRING_TEXT, size);
+		string = rom + SNEK_STRING_TEXT;
+	}
+#endif
 	snek_stack_push_string(string);
 	snek_code_add_op_offset(snek_op_string, 0);
-	s = snek_pool_offset(snek_stack_pop_string(string));
+	s = snek_pool_offset(snek_stack_pop_string(string) - SNEK_STRING_TEXT);
 	memcpy(snek_compile + snek_compile_prev + 1, &s, sizeof (snek_offset_t));
 }
 
@@ -234,7 +271,8 @@ snek_code_add_in_enum(snek_id_t id, uint8_t for_depth)
 }
 
 /*
- * Patch pending branch once the target instruction is known
+ * Patch pending branch once the target instruction is known. A
+ * 'break' out of a 'for i in range' loop also pops the loop state
  */
 void
 snek_code_patch_forward(snek_offset_t start, snek_offset_t stop, snek_forward_t forward, snek_offset_t target)
@@ -250,7 +288,11 @@ snek_code_patch_forward(snek_offset_t start, snek_offset_t stop, snek_forward_t
 		case snek_op_forward:
 			memcpy(&f, &snek_compile[ip], sizeof (snek_offset_t));
 			if ((snek_forward_t) (f & 0xff) == forward) {
-				snek_compile[ip-1] = f >> 8 | push;
+				snek_op_t fop = f >> 8;
+				if (forward == snek_forward_break &&
+				    (snek_compile[start] & ~snek_op_push) == snek_op_range_step)
+					fop = snek_op_range_break;
+				snek_compile[ip-1] = fop | push;
 				memcpy(&snek_compile[ip], &target, sizeof(snek_offset_t));
 			}
 			break;
@@ -272,6 +314,461 @@ snek_code_reset(void)
 	snek_compile = NULL;
 }
 
+#if defined(SNEK_FUSE) || defined(SNEK_LINE_TABLE)
+#define SNEK_CODE_REWRITE
+#endif
+
+#if defined(SNEK_CODE_REWRITE) || defined(SNEK_FOLD)
+
+/*
+ * Return whether the first operand of 'op' is a branch target
+ */
+static bool
+finish_branches(snek_op_t op)
+{
+	switch (op) {
+	case snek_op_chain_eq:
+	case snek_op_chain_ne:
+	case snek_op_chain_gt:
+	case snek_op_chain_lt:
+	case snek_op_chain_ge:
+	case snek_op_chain_le:
+	case snek_op_branch:
+	case snek_op_branch_true:
+	case snek_op_branch_false:
+	case snek_op_range_step:
+	case snek_op_range_break:
+	case snek_op_in_step:
+#ifdef SNEK_FUSE
+	case snek_op_eq_branch_false:
+	case snek_op_ne_branch_false:
+	case snek_op_gt_branch_false:
+	case snek_op_lt_branch_false:
+	case snek_op_ge_branch_false:
+	case snek_op_le_branch_false:
+#endif
+		return true;
+	default:
+		return false;
+	}
+}
+
+#endif
+
+#ifdef SNEK_FOLD
+
+/*
+ * Constant folding. Operators applied to immediate numbers are
+ * evaluated while compiling and replaced by the result. True and
+ * False are ordinary names which a program may rebind, so they are
+ * never treated as constants, and results which would need them,
+ * like 'not 0', are left alone. Only results which are computed
+ * exactly as the interpreter would, and which can be stored in an
+ * immediate, are folded; anything else is left for the interpreter
+ * to evaluate and report.
+ */
+
+/*
+ * Fetch the value of the number instruction at 'ip', returning the
+ * offset of the following instruction or 0 if it isn't a number
+ */
+static snek_offset_t
+fold_constant(snek_offset_t ip, float *value)
+{
+	snek_op_t	op = snek_compile[ip] & ~snek_op_push;
+
+	switch (op) {
+	case snek_op_int:
+		*value = (float) (int8_t) snek_compile[ip + 1];
+		break;
+	case snek_op_num:
+		memcpy(value, &snek_compile[ip + 1], sizeof (float));
+		break;
+	default:
+		return 0;
+	}
+	return ip + 1 + snek_op_operand_size(op);
+}
+
+/*
+ * Return whether the code from 'start' to 'end' is a single number
+ * instruction, fetching its value
+ */
+bool
+snek_code_constant(snek_offset_t start, snek_offset_t end, float *value)
+{
+	return start < end && fold_constant(start, value) == end;
+}
+
+/*
+ * Convert a float to an int, if it is exactly representable
+ */
+static bool
+fold_int(float f, int32_t *i)
+{
+	if (!(-2147483648.0f <= f && f < 2147483648.0f))
+		return false;
+	*i = (int32_t) f;
+	return (float) *i == f;
+}
+
+/*
+ * Replace the operand(s) starting at 'start' with the number 'f',
+ * when the immediate holds exactly that value
+ */
+static bool
+fold_number(snek_offset_t start, float f)
+{
+	/* Leave infinities, NaNs and -0 to the interpreter */
+	if (!isfinite(f) || (f == 0.0f && signbit(f)))
+		return false;
+	/* The instruction before the operands isn't known, so
+	 * snek_compile_prev_prev is left pointing at the new one
+	 */
+	snek_compile_size = start;
+	snek_compile_prev = start;
+	snek_code_add_number(f);
+	return true;
+}
+
+/*
+ * Evaluate the unary operator 'op' when its operand, starting at
+ * 'start', is constant
+ */
+bool
+snek_code_fold_unop(snek_offset_t start, snek_op_t op)
+{
+	float		af;
+	int32_t		i;
+
+	if (!snek_code_constant(start, snek_compile_size, &af))
+		return false;
+	switch (op) {
+	case snek_op_uminus:
+		return fold_number(start, -af);
+	case snek_op_lnot:
+		if (!fold_int(af, &i))
+			return false;
+		return fold_number(start, (float) ~(uint32_t) i);
+	default:
+		return false;
+	}
+}
+
+/*
+ * Evaluate the binary operator 'op' when its left operand is the
+ * constant at 'left' and its right operand is the constant following
+ * that
+ */
+bool
+snek_code_fold_binop(snek_offset_t left, snek_op_t op)
+{
+	float		af, bf;
+	snek_offset_t	right = fold_constant(left, &af);
+	int32_t		ai, bi;
+
+	if (!right || !snek_code_constant(right, snek_compile_size, &bf))
+		return false;
+
+	switch (op) {
+	case snek_op_plus:
+		return fold_number(left, af + bf);
+	case snek_op_minus:
+		return fold_number(left, af - bf);
+	case snek_op_times:
+		return fold_number(left, af * bf);
+	case snek_op_divide:
+		return fold_number(left, af / bf);
+	case snek_op_div:
+		return fold_number(left, floorf(af / bf));
+	case snek_op_mod:
+		return fold_number(left, af - floorf(af/bf) * bf);
+	case snek_op_pow:
+		return fold_number(left, powf(af, bf));
+	default:
+		break;
+	}
+
+	/* Bitwise operators need integer values */
+	if (!fold_int(af, &ai) || !fold_int(bf, &bi))
+		return false;
+	switch (op) {
+	case snek_op_land:
+		return fold_number(left, (float) (ai & bi));
+	case snek_op_lor:
+		return fold_number(left, (float) (ai | bi));
+	case snek_op_lxor:
+		return fold_number(left, (float) (ai ^ bi));
+	case snek_op_lshift:
+		if (bi < 0 || 31 < bi)
+			return false;
+		return fold_number(left, (float) (ai << bi));
+	case snek_op_rshift:
+		if (bi < 0 || 31 < bi)
+			return false;
+		return fold_number(left, (float) (ai >> bi));
+	default:
+		return false;
+	}
+}
+
+/*
+ * Remove the code from 'start' to 'end', which no other code
+ * branches into, moving the rest down and adjusting branches to it
+ */
+void
+snek_code_delete(snek_offset_t start, snek_offset_t end)
+{
+	snek_offset_t	len = end - start;
+	snek_offset_t	ip;
+	snek_op_t	op;
+	snek_offset_t	target;
+
+	memmove(snek_compile + start, snek_compile + end, snek_compile_size - end);
+	snek_compile_size -= len;
+	snek_compile_prev = snek_compile_prev_prev = 0;
+	for (ip = 0; ip < snek_compile_size; ip += 1 + snek_op_operand_size(op)) {
+		snek_compile_prev_prev = snek_compile_prev;
+		snek_compile_prev = ip;
+		op = snek_compile[ip] & ~snek_op_push;
+		if (finish_branches(op)) {
+			memcpy(&target, &snek_compile[ip + 1], sizeof (snek_offset_t));
+			if (target >= end) {
+				target -= len;
+				memcpy(&snek_compile[ip + 1], &target, sizeof (snek_offset_t));
+			}
+		}
+	}
+}
+
+#endif
+
+#ifdef SNEK_FUSE
+
+/*
+ * Superinstructions. When the bytecode for a block is complete,
+ * common pairs of instructions are replaced by a single instruction
+ * holding the operands of both, saving a dispatch and a byte. A
+ * pair is left alone when anything branches to the second
+ * instruction, or when the first pushes its value.
+ */
+
+static bool
+fuse_is_target(snek_offset_t target)
+{
+	snek_offset_t	ip;
+	snek_op_t	op;
+	snek_offset_t	o;
+
+	for (ip = 0; ip < snek_compile_size; ip += 1 + snek_op_operand_size(op)) {
+		op = snek_compile[ip] & ~snek_op_push;
+		if (finish_branches(op)) {
+			memcpy(&o, &snek_compile[ip + 1], sizeof (snek_offset_t));
+			if (o == target)
+				return true;
+		}
+	}
+	return false;
+}
+
+/*
+ * Find the superinstruction replacing the instruction at 'ip' and
+ * the one following it, or snek_op_nop if there isn't one
+ */
+static snek_op_t
+fuse_op(snek_offset_t ip)
+{
+	snek_op_t	first = snek_compile[ip];
+	snek_offset_t	next = ip + 1 + snek_op_operand_size(first & ~snek_op_push);
+	snek_op_t	second;
+	snek_op_t	fused = snek_op_nop;
+
+	if (next >= snek_compile_size)
+		return snek_op_nop;
+	second = snek_compile[next] & ~snek_op_push;
+	switch (first) {
+	case snek_op_int:
+		if (second <= snek_op_le)
+			fused = second - snek_op_eq + snek_op_eq_i;
+		else if (snek_op_plus <= second && second <= snek_op_times)
+			fused = second - snek_op_plus + snek_op_plus_i;
+		break;
+	case snek_op_eq:
+	case snek_op_ne:
+	case snek_op_gt:
+	case snek_op_lt:
+	case snek_op_ge:
+	case snek_op_le:
+		if (second == snek_op_branch_false)
+			fused = first - snek_op_eq + snek_op_eq_branch_false;
+		break;
+	default:
+		break;
+	}
+	if (fused == snek_op_nop || fuse_is_target(next))
+		return snek_op_nop;
+	return fused | (snek_compile[next] & snek_op_push);
+}
+
+static bool
+fuse_is_fused(snek_op_t op)
+{
+	return snek_op_plus_i <= op && op <= snek_op_le_branch_false;
+}
+
+#endif
+
+#ifdef SNEK_LINE_TABLE
+
+/*
+ * Line numbers. Instead of leaving snek_op_line instructions in the
+ * code, they are collected into a table stored after the
+ * bytecode. Each entry is a pair of bytes holding the distance from
+ * the previous entry's ip and the (signed) change in line
+ * number. Larger changes are split across several entries.
+ */
+
+static snek_offset_t
+finish_line(uint8_t *lines, snek_offset_t n, snek_offset_t ip_delta, int32_t line_delta)
+{
+	while (ip_delta > 255) {
+		if (lines) {
+			lines[n] = 255;
+			lines[n + 1] = 0;
+		}
+		n += 2;
+		ip_delta -= 255;
+	}
+	do {
+		int8_t step = line_delta > 127 ? 127 : line_delta < -128 ? -128 : line_delta;
+
+		if (lines) {
+			lines[n] = ip_delta;
+			lines[n + 1] = (uint8_t) step;
+		}
+		n += 2;
+		ip_delta = 0;
+		line_delta -= step;
+	} while (line_delta);
+	return n;
+}
+
+#endif
+
+#ifdef SNEK_CODE_REWRITE
+
+/*
+ * Copy snek_compile to 'out', replacing pairs with superinstructions
+ * and moving line numbers to 'lines'. With 'out' NULL, just compute
+ * the resulting sizes
+ */
+static snek_offset_t
+finish_copy(uint8_t *out, uint8_t *lines, snek_offset_t *nline)
+{
+	snek_offset_t	in = 0;
+	snek_offset_t	o = 0;
+#ifdef SNEK_LINE_TABLE
+	snek_offset_t	n = 0;
+	snek_offset_t	line_ip = 0;
+	snek_offset_t	line = 0;
+#else
+	(void) lines;
+#endif
+
+	while (in < snek_compile_size) {
+		snek_offset_t	len = 1 + snek_op_operand_size(snek_compile[in] & ~snek_op_push);
+
+#ifdef SNEK_LINE_TABLE
+		if ((snek_compile[in] & ~snek_op_push) == snek_op_line) {
+			snek_offset_t	l;
+
+			memcpy(&l, &snek_compile[in + 1], sizeof (snek_offset_t));
+			n = finish_line(lines, n, o - line_ip, (int32_t) l - (int32_t) line);
+			line_ip = o;
+			line = l;
+			in += len;
+			continue;
+		}
+#endif
+#ifdef SNEK_FUSE
+		snek_op_t	fused = fuse_op(in);
+
+		if (fused != snek_op_nop) {
+			/* Replace the first opcode, copy its operands and
+			 * then skip the second opcode
+			 */
+			if (out) {
+				out[o] = fused;
+				memcpy(&out[o + 1], &snek_compile[in + 1], len - 1);
+			}
+			o += len;
+			in += len;
+			len = snek_op_operand_size(snek_compile[in] & ~snek_op_push);
+			in++;
+		}
+#endif
+		if (out)
+			memcpy(&out[o], &snek_compile[in], len);
+		o += len;
+		in += len;
+	}
+#ifdef SNEK_LINE_TABLE
+	*nline = n;
+#else
+	*nline = 0;
+#endif
+	return o;
+}
+
+/*
+ * Map a branch target in snek_compile to the matching
+ * location in the new code
+ */
+static snek_offset_t
+finish_relocate(uint8_t *out, snek_offset_t target)
+{
+	snek_offset_t	in = 0;
+	snek_offset_t	o = 0;
+
+	while (in < target) {
+#ifdef SNEK_LINE_TABLE
+		if ((snek_compile[in] & ~snek_op_push) == snek_op_line) {
+			in += 1 + sizeof (snek_offset_t);
+			continue;
+		}
+#endif
+		snek_op_t	op = out[o] & ~snek_op_push;
+		snek_offset_t	len = 1 + snek_op_operand_size(op);
+
+		in += len;
+#ifdef SNEK_FUSE
+		if (fuse_is_fused(op))
+			in++;
+#endif
+		o += len;
+	}
+	return o;
+}
+
+static void
+finish_relocate_all(uint8_t *out, snek_offset_t size)
+{
+	snek_offset_t	ip;
+	snek_op_t	op;
+	snek_offset_t	target;
+
+	for (ip = 0; ip < size; ip += 1 + snek_op_operand_size(op)) {
+		op = out[ip] & ~snek_op_push;
+		if (finish_branches(op)) {
+			memcpy(&target, &out[ip + 1], sizeof (snek_offset_t));
+			target = finish_relocate(out, target);
+			memcpy(&out[ip + 1], &target, sizeof (snek_offset_t));
+		}
+	}
+}
+
+#endif
+
 /*
  * Construct a code object from the current bytecode buffer
  */
@@ -280,11 +777,33 @@ snek_code_finish(void)
 {
 	if (snek_compile_size == 0)
 		return NULL;
-	snek_code_t *code = snek_alloc(sizeof (snek_code_t) + snek_compile_size);
+#ifdef SNEK_CODE_REWRITE
+	snek_offset_t nline;
+	snek_offset_t size = finish_copy(NULL, NULL, &nline);
+#else
+	snek_offset_t size = snek_compile_size;
+	snek_offset_t nline = 0;
+#endif
+#ifdef SNEK_ROM
+	/* Code for an image goes in the read-only region */
+	snek_code_t *code = (snek_image_build ?
+			     snek_rom_alloc(sizeof (snek_code_t) + size + nline) :
+			     snek_alloc(sizeof (snek_code_t) + size + nline));
+#else
+	snek_code_t *code = snek_alloc(sizeof (snek_code_t) + size + nline);
+#endif
 
 	if (code) {
+#ifdef SNEK_CODE_REWRITE
+		finish_copy(code->code, code->code + size, &nline);
+		finish_relocate_all(code->code, size);
+#else
 		memcpy(&code->code, snek_compile, snek_compile_size);
-		code->size = snek_compile_size;
+#endif
+		code->size = size;
+#ifdef SNEK_LINE_TABLE
+		code->lines = nline;
+#endif
 #ifdef DEBUG_COMPILE
 		snek_code_dump(code);
 #endif
@@ -297,6 +816,42 @@ snek_code_finish(void)
  * Find the first line in the specified code block. This is
  * used when printing out function objects
  */
+#ifdef SNEK_LINE_TABLE
+snek_offset_t
+snek_code_line(snek_code_t *code)
+{
+	const uint8_t	*lines = code->code + code->size;
+	snek_offset_t	e;
+	snek_offset_t	ip = 0;
+
+	for (e = 0; e < code->lines; e += 2) {
+		ip += lines[e];
+		if (lines[e + 1])
+			return snek_code_line_at(code, ip);
+	}
+	return 0;
+}
+
+/*
+ * Find the line holding the instruction at 'at'
+ */
+snek_offset_t
+snek_code_line_at(snek_code_t *code, snek_offset_t at)
+{
+	const uint8_t	*lines = code->code + code->size;
+	snek_offset_t	e;
+	snek_offset_t	ip = 0;
+	snek_offset_t	line = 0;
+
+	for (e = 0; e < code->lines; e += 2) {
+		ip += lines[e];
+		if (ip > at)
+			break;
+		line += (int8_t) lines[e + 1];
+	}
+	return line;
+}
+#else
 snek_offset_t
 snek_code_line(snek_code_t *code)
 {
@@ -313,6 +868,7 @@ snek_code_line(snek_code_t *code)
 	}
 	return line;
 }
+#endif
 
 
 static snek_offset_t
@@ -320,7 +876,11 @@ snek_code_size(void *addr)
 {
 	snek_code_t *code = addr;
 
+#ifdef SNEK_LINE_TABLE
+	return (snek_offset_t) sizeof (snek_code_t) + code->size + code->lines;
+#else
 	return (snek_offset_t) sizeof (snek_code_t) + code->size;
+#endif
 }
 
 static void
@@ -331,6 +891,12 @@ code_mark(uint8_t *code, snek_offset_t size)
 	while (ip < size) {
 		snek_op_t op = code[ip++] & ~snek_op_push;
 		snek_offset_t o;
+
+		/* The compiler may be in the middle of adding this
+		 * instruction; skip it until the operand is present
+		 */
+		if (size - ip < snek_op_operand_size(op))
+			break;
 		switch (op) {
 		case snek_op_string:
 			memcpy(&o, &code[ip], sizeof (snek_offset_t));
@@ -350,6 +916,8 @@ code_move(uint8_t *code, snek_offset_t size)
 
 	while (ip < size) {
 		snek_op_t op = code[ip++] & ~snek_op_push;
+		if (size - ip < snek_op_operand_size(op))
+			break;
 		switch (op) {
 		case snek_op_string:
 			snek_move_block_offset(&code[ip]);
@@ -447,6 +1015,10 @@ static const char * const snek_op_names[] = {
 	[snek_op_list] = "list",
 	[snek_op_tuple] = "tuple",
 	[snek_op_id] = "id",
+#ifdef SNEK_LOCAL_SLOTS
+	[snek_op_local] = "local",
+	[snek_op_assign_local] = "assign_local",
+#endif
 
 
 	[snek_op_not] = "not",
@@ -490,12 +1062,48 @@ static const char * const snek_op_names[] = {
 	[snek_op_forward] = "forward",
 	[snek_op_range_start] = "range_start",
 	[snek_op_range_step] = "range_step",
+	[snek_op_range_break] = "range_break",
+	[snek_op_range_drop] = "range_drop",
 	[snek_op_in_step] = "in_step",
 	[snek_op_return] = "return",
 
 	[snek_op_null] = "null",
 	[snek_op_nop] = "nop",
 	[snek_op_line] = "line",
+
+#ifdef SNEK_QUICKEN
+	[snek_op_plus_f] = "plus_f",
+	[snek_op_minus_f] = "minus_f",
+	[snek_op_times_f] = "times_f",
+	[snek_op_divide_f] = "divide_f",
+
+	[snek_op_eq_f] = "eq_f",
+	[snek_op_ne_f] = "ne_f",
+	[snek_op_gt_f] = "gt_f",
+	[snek_op_lt_f] = "lt_f",
+	[snek_op_ge_f] = "ge_f",
+	[snek_op_le_f] = "le_f",
+#endif
+
+#ifdef SNEK_FUSE
+	[snek_op_plus_i] = "plus_i",
+	[snek_op_minus_i] = "minus_i",
+	[snek_op_times_i] = "times_i",
+
+	[snek_op_eq_i] = "eq_i",
+	[snek_op_ne_i] = "ne_i",
+	[snek_op_gt_i] = "gt_i",
+	[snek_op_lt_i] = "lt_i",
+	[snek_op_ge_i] = "ge_i",
+	[snek_op_le_i] = "le_i",
+
+	[snek_op_eq_branch_false] = "eq_branch_false",
+	[snek_op_ne_branch_false] = "ne_branch_false",
+	[snek_op_gt_branch_false] = "gt_branch_false",
+	[snek_op_lt_branch_false] = "lt_branch_false",
+	[snek_op_ge_branch_false] = "ge_branch_false",
+	[snek_op_le_branch_false] = "le_branch_false",
+#endif
 };
 
 snek_offset_t
@@ -518,20 +1126,35 @@ snek_code_dump_instruction(snek_code_t *code, snek_offset_t ip)
 		dbg("%.7g\n", f);
 		break;
 	case snek_op_int:
+#ifdef SNEK_FUSE
+	case snek_op_plus_i:
+	case snek_op_minus_i:
+	case snek_op_times_i:
+	case snek_op_eq_i:
+	case snek_op_ne_i:
+	case snek_op_gt_i:
+	case snek_op_lt_i:
+	case snek_op_ge_i:
+	case snek_op_le_i:
+#endif
 		memcpy(&i8, &code->code[ip], sizeof(int8_t));
 		dbg("%d\n", i8);
 		break;
 	case snek_op_string:
 		memcpy(&o, &code->code[ip], sizeof(snek_offset_t));
-		dbg("%s\n", (char *) snek_pool_addr(o));
+		dbg("%s\n", snek_poly_to_string(snek_offset_to_poly(o, snek_string)));
 		break;
 	case snek_op_list:
 	case snek_op_tuple:
+#ifndef SNEK_NO_DICT
+	case snek_op_dict:
+#endif
 		memcpy(&o, &code->code[ip], sizeof(snek_offset_t));
 		dbg("%u\n", o);
 		break;
 	case snek_op_id:
 	case snek_op_global:
+	case snek_op_del:
 	case snek_op_assign:
 	case snek_op_assign_named:
 	case snek_op_assign_plus:
@@ -557,6 +1180,13 @@ snek_code_dump_instruction(snek_code_t *code, snek_offset_t ip)
 		} else
 			dbg("<array>\n");
 		break;
+#ifdef SNEK_LOCAL_SLOTS
+	case snek_op_local:
+	case snek_op_assign_local:
+		memcpy(&id, &code->code[ip], sizeof(snek_id_t));
+		dbg("slot %d\n", id);
+		break;
+#endif
 	case snek_op_call:
 		memcpy(&o, &code->code[ip], sizeof(snek_offset_t));
 		dbg("%d position %d named\n", o & 0xff, o >> 8);
@@ -575,8 +1205,17 @@ snek_code_dump_instruction(snek_code_t *code, snek_offset_t ip)
 	case snek_op_branch:
 	case snek_op_branch_true:
 	case snek_op_branch_false:
+	case snek_op_range_break:
 	case snek_op_forward:
 	case snek_op_line:
+#ifdef SNEK_FUSE
+	case snek_op_eq_branch_false:
+	case snek_op_ne_branch_false:
+	case snek_op_gt_branch_false:
+	case snek_op_lt_branch_false:
+	case snek_op_ge_branch_false:
+	case snek_op_le_branch_false:
+#endif
 		memcpy(&o, &code->code[ip], sizeof (snek_offset_t));
 		dbg("%d\n", o);
 		break;
@@ -603,8 +1242,17 @@ static void
 snek_code_dump(snek_code_t *code)
 {
 	snek_offset_t	ip = 0;
+#ifdef SNEK_LINE_TABLE
+	snek_offset_t	line = 0;
+#endif
 
 	while (ip < code->size) {
+#ifdef SNEK_LINE_TABLE
+		if (snek_code_line_at(code, ip) != line) {
+			line = snek_code_line_at(code, ip);
+			dbg("line %d\n", line);
+		}
+#endif
 		ip = snek_code_dump_instruction(code, ip);
 	}
 }
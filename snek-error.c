@@ -50,6 +50,10 @@ snek_error_name(const char *format, ...)
 		return SNEK_NULL;
 	snek_abort = true;
 	va_start(args, format);
+#ifdef SNEK_LINE_TABLE
+	if (snek_code)
+		snek_line = snek_code_line_at(snek_code, snek_exec_ip);
+#endif
 	fprintf(stderr, "%s:%d ", snek_file, snek_line);
 	while ((c = ERROR_FETCH_FORMAT_CHAR(format++))) {
 		if (c == '%') {
@@ -22,6 +22,9 @@ snek_poly_t	snek_stack[SNEK_STACK];	/* value stack */
 snek_offset_t	snek_stackp;		/* value stack pointer  */
 snek_poly_t 	snek_a = SNEK_NULL;	/* accumulator */
 snek_code_t	*snek_code;		/* current code pointer */
+#ifdef SNEK_LINE_TABLE
+snek_offset_t	snek_exec_ip;		/* current instruction, for error messages */
+#endif
 
 /*
  * Push a value to the stack, raise an error if the stack overflows
@@ -97,6 +100,23 @@ snek_stack_pop_soffset(void)
 	return (snek_soffset_t) snek_stack_pop_float();
 }
 
+/*
+ * 'for i in range' loops keep their state on the value stack: the
+ * start, the step, the index of the next iteration and the number of
+ * iterations. The index and count are integers stored directly in
+ * the bits of the stack entries; any value below the float exponent
+ * mask looks like a float to the rest of snek, so the collector
+ * leaves it alone. Each value of the loop variable is computed as
+ * start + index * step instead of adding up steps, and the loop
+ * variable is only written, never read, so assigning to it in the
+ * body doesn't change the iteration.
+ *
+ * The state is popped when the loop runs out; 'break' and 'return'
+ * use range_break and range_drop to pop it on their way out.
+ */
+#define SNEK_RANGE_STATE	4
+#define SNEK_RANGE_MAX		0x7f000000u
+
 /*
  * Start a 'for i in range' statement
  */
@@ -104,13 +124,9 @@ static void
 snek_range_start(snek_offset_t ip)
 {
 	snek_offset_t	nactual;	/* number of actuals passed to 'range' */
-	snek_id_t	id;		/* variable used in the 'for' statement */
-	uint8_t		for_depth;	/* loop nesting depth (used to build temp var names) */
 
 	/* Fetch params from instruction */
 	memcpy(&nactual, &snek_code->code[ip], sizeof(snek_offset_t));
-	memcpy(&id, &snek_code->code[ip + sizeof(snek_offset_t) + sizeof (uint8_t)], sizeof (snek_id_t));
-	memcpy(&for_depth, &snek_code->code[ip + sizeof(snek_offset_t)], sizeof (uint8_t));
 
 	/* Compute the loop parameters given the actuals provided to the range function */
 	float current = 0.0f;
@@ -140,26 +156,17 @@ snek_range_start(snek_offset_t ip)
 		return;
 	}
 
-	/* Assign initial value (current - step) */
-
-	snek_poly_t	*id_ref = snek_id_ref(id, true);
-	if(!id_ref)
-		return;
-	*id_ref = snek_float_to_poly(current - step);
-
-	/* Save limit in tmp variable */
-	snek_poly_t	*limit_ref = snek_id_ref(snek_for_tmp(for_depth, 0), true);
-	if (!limit_ref)
-		return;
-	*limit_ref = snek_float_to_poly(limit);
-
-	/* Save step in tmp variable */
-	snek_poly_t	*step_ref = snek_id_ref(snek_for_tmp(for_depth, 1), true);
-	if (!step_ref)
-		return;
-	*step_ref = snek_float_to_poly(step);
-
-	return;
+	/* Count the iterations */
+	float n = ceilf((limit - current) / step);
+	snek_poly_t count = { .u = 0 };
+	if (n > 0)
+		count.u = n < (float) SNEK_RANGE_MAX ? (uint32_t) n : SNEK_RANGE_MAX;
+
+	/* Save start, step, index and count on the stack */
+	snek_stack_push(snek_float_to_poly(current));
+	snek_stack_push(snek_float_to_poly(step));
+	snek_stack_push((snek_poly_t) { .u = 0 });
+	snek_stack_push(count);
 }
 
 /*
@@ -168,29 +175,25 @@ snek_range_start(snek_offset_t ip)
 static bool
 snek_range_step(snek_offset_t ip)
 {
-	uint8_t		for_depth;	/* nesting depth of loop */
 	snek_id_t	id;		/* id of the 'for' variable */
+	snek_poly_t	*state = &snek_stack[snek_stackp - SNEK_RANGE_STATE];
 
-	memcpy(&for_depth, &snek_code->code[ip + sizeof(snek_offset_t)], sizeof (uint8_t));
-	memcpy(&id, &snek_code->code[ip + sizeof(snek_offset_t) + sizeof (uint8_t)], sizeof (snek_id_t));
-
-	/* Go get refernences to all three variables */
-	snek_poly_t	*id_ref = snek_id_ref(id, false);
-	snek_poly_t	*limit_ref = snek_id_ref(snek_for_tmp(for_depth, 0), false);
-	snek_poly_t	*step_ref = snek_id_ref(snek_for_tmp(for_depth, 1), false);
-
-	if (!id_ref || !limit_ref || !step_ref)
+	/* Check to see if we're done */
+	if (state[2].u == state[3].u) {
+		snek_stack_drop(SNEK_RANGE_STATE);
 		return false;
+	}
+	uint32_t index = state[2].u++;
 
 	/* Compute the next value in the sequence */
-	float step = snek_poly_get_float(*step_ref);
-	float value = snek_poly_get_float(*id_ref) + step;
-	*id_ref = snek_float_to_poly(value);
+	float value = state[0].f + (float) index * state[1].f;
 
-	/* Check to see if we're done */
-	float limit = snek_poly_get_float(*limit_ref);
-	if (step > 0 ? value >= limit : value <= limit)
+	/* Store it, which may allocate */
+	memcpy(&id, &snek_code->code[ip + sizeof(snek_offset_t) + sizeof (uint8_t)], sizeof (snek_id_t));
+	snek_poly_t	*id_ref = snek_id_ref_ip(id, true, ip);
+	if (!id_ref)
 		return false;
+	*id_ref = snek_float_to_poly(value);
 
 	/* keep going */
 	return true;
@@ -209,12 +212,12 @@ snek_in_step(snek_offset_t ip)
 	memcpy(&for_depth, &snek_code->code[ip + sizeof(snek_offset_t)], sizeof(uint8_t));
 
 	/* Get current index, save next index */
-	snek_poly_t *i_ref = snek_id_ref(snek_for_tmp(for_depth, 1), false);
+	snek_poly_t *i_ref = snek_id_ref_ip(snek_for_tmp(for_depth, 1), false, ip + 1);
 	snek_soffset_t i = snek_poly_get_soffset(*i_ref);
 	*i_ref = snek_soffset_to_poly(i + 1);
 
 	/* Fetch iterable */
-	snek_poly_t array = *snek_id_ref(snek_for_tmp(for_depth, 0), false);
+	snek_poly_t array = *snek_id_ref_ip(snek_for_tmp(for_depth, 0), false, ip);
 
 	/* Compute current value */
 	snek_poly_t value = SNEK_NULL;
@@ -226,8 +229,13 @@ snek_in_step(snek_offset_t ip)
 	case snek_list:
 		list = snek_poly_to_list(array);
 #ifndef SNEK_NO_DICT
-		if (snek_list_type(list) == snek_list_dict)
+		if (snek_list_type(list) == snek_list_dict) {
+#ifdef SNEK_DICT_HASH
+			if (i == 0)
+				snek_dict_sort(list);
+#endif
 			i *= 2;
+		}
 #endif
 		if ((snek_offset_t) i < list->size)
 			value = snek_list_data(list)[(snek_offset_t) i];
@@ -247,7 +255,7 @@ snek_in_step(snek_offset_t ip)
 	memcpy(&id, &snek_code->code[ip + sizeof(snek_offset_t) + sizeof (uint8_t)], sizeof (snek_id_t));
 
 	snek_stack_push(value);
-	ref = snek_id_ref(id, true);
+	ref = snek_id_ref_ip(id, true, ip + 3);
 	value = snek_stack_pop();
 	if (!ref)
 		return false;
@@ -401,6 +409,11 @@ snek_binary(snek_poly_t a, snek_op_t op, snek_poly_t b, bool inplace)
 #endif
 					1;
 				found = false;
+#ifdef SNEK_DICT_HASH
+				if (step == 2)
+					found = snek_dict_has(bl, a);
+				else
+#endif
 				for (o = 0; o < bl->size; o += step) {
 					if (snek_poly_cmp(a, snek_list_data(bl)[o], false) == 0) {
 						found = true;
@@ -598,7 +611,7 @@ snek_undefined(snek_id_t id)
  * Perform assignment, both regular and enhanced (op=)
  */
 static void
-snek_assign(snek_id_t id, snek_op_t op)
+snek_assign(snek_id_t id, snek_op_t op, snek_offset_t ip)
 {
 	snek_poly_t *ref;
 
@@ -618,7 +631,7 @@ snek_assign(snek_id_t id, snek_op_t op)
 			if (!is_pure_assign && snek_frame && !snek_id_is_local(id))
 				ref = NULL;
 			else
-				ref = snek_id_ref(id, is_pure_assign);
+				ref = snek_id_ref_ip(id, is_pure_assign, ip);
 			if (!ref) {
 				snek_undefined(id);
 				return;
@@ -627,7 +640,7 @@ snek_assign(snek_id_t id, snek_op_t op)
 			/* Array operator assignment (a[x] = expr) */
 
 			/* Fetch the index and list values off the stack */
-			snek_poly_t ip = snek_stack_pop();
+			snek_poly_t xp = snek_stack_pop();
 			snek_poly_t lp = snek_stack_pop();
 
 			snek_list_t	*l;
@@ -643,7 +656,7 @@ snek_assign(snek_id_t id, snek_op_t op)
 			/* Get a reference to the value location within the
 			 * list
 			 */
-			ref = snek_list_ref(l, ip, true);
+			ref = snek_list_ref(l, xp, true);
 			if (!ref)
 				return;
 		}
@@ -721,6 +734,207 @@ snek_call_builtin(const snek_builtin_t *builtin, uint8_t nposition, uint8_t nnam
 	}
 }
 
+#ifdef DEBUG_EXEC
+static void
+snek_exec_show(snek_poly_t a, snek_offset_t sp)
+{
+	snek_offset_t o;
+
+	fprintf(stderr, "\t\ta= ");
+	snek_poly_print(stderr, a, 'r');
+	for (o = sp; o;) {
+		fprintf(stderr, ", [%d]= ", sp - o);
+		snek_poly_print(stderr, snek_stack[--o], 'r');
+	}
+	fprintf(stderr, "\n");
+}
+#define snek_exec_trace()	snek_exec_show(a, sp)
+#define snek_exec_dump(ip)	snek_code_dump_instruction(snek_code, ip)
+#else
+#define snek_exec_trace()
+#define snek_exec_dump(ip)
+#endif
+
+/*
+ * Without snek_op_line instructions, errors find the current line
+ * from the line table using the address of the running instruction
+ */
+#ifdef SNEK_LINE_TABLE
+#define snek_exec_at(ip)	(snek_exec_ip = (ip))
+#else
+#define snek_exec_at(ip)
+#endif
+
+/*
+ * While running instructions, the accumulator, the stack pointer
+ * and the address of the current bytecode are kept in locals so
+ * that the compiler can hold them in registers instead of reloading
+ * the globals after every store and call. Anything which uses the
+ * globals or might allocate memory needs them spilled back first,
+ * then filled again afterwards as a collection can move the code
+ * and whatever the accumulator refers to.
+ */
+#define snek_spill()	(snek_a = a, snek_stackp = sp)
+#define snek_fill_code() (code = snek_code->code)
+#define snek_fill()	(a = snek_a, sp = snek_stackp, snek_fill_code())
+
+#define snek_pick(off)	(snek_stack[sp - (off) - 1])
+#define snek_drop(off)	(sp -= (off))
+
+/* Call snek_binary, which may allocate */
+#define snek_exec_binary(l, op, r) do {					\
+		snek_spill();						\
+		snek_a = snek_binary(l, op, r, false);			\
+		snek_fill();						\
+	} while (0)
+
+/* Push the accumulator, leaving the error path out of line */
+#define snek_push() do {						\
+		if (sp == SNEK_STACK)					\
+			goto overflow;					\
+		snek_stack[sp++] = a;					\
+	} while (0)
+
+/*
+ * Each instruction ends by moving on to the next one. Only
+ * instructions which can raise an error check snek_abort after
+ * running; otherwise it is checked at backward branches and calls
+ * so that an interrupt can still stop a running loop.
+ *
+ * With SNEK_EXEC_THREADED, every instruction fetches the next op
+ * and jumps directly to its handler through a table of label
+ * addresses (a GCC extension) instead of going back through the
+ * switch, which gives each handler its own, better predicted,
+ * dispatch branch. The switch remains to start each code block.
+ */
+#ifdef SNEK_EXEC_THREADED
+#define snek_case(op)	case op: label_ ## op
+#define snek_next() do {						\
+		if (push)						\
+			snek_push();					\
+		snek_exec_trace();					\
+		if (ip >= snek_code->size)				\
+			goto code_done;					\
+		snek_exec_dump(ip);					\
+		snek_exec_at(ip);					\
+		op = code[ip++];					\
+		push = (op & snek_op_push) != 0;			\
+		op &= ~snek_op_push;					\
+		goto *snek_exec_ops[op];				\
+	} while (0)
+#else
+#define snek_case(op)	case op
+#define snek_next()	goto next
+#endif
+
+#define snek_next_check() do {						\
+		if (snek_abort)						\
+			goto abort;					\
+		snek_next();						\
+	} while (0)
+
+/* Jump to target, checking for an interrupt when going backwards */
+#define snek_branch(target) do {					\
+		if ((target) < ip && snek_abort)			\
+			goto abort;					\
+		ip = (target);						\
+		snek_next();						\
+	} while (0)
+
+/* Float comparisons matching snek_poly_cmp, which treats NaN as equal to everything */
+#define snek_float_eq(af, bf)	(((bf) < (af)) == ((af) < (bf)))
+#define snek_float_ne(af, bf)	(((bf) < (af)) != ((af) < (bf)))
+#define snek_float_gt(af, bf)	((bf) < (af))
+#define snek_float_lt(af, bf)	((af) < (bf))
+#define snek_float_ge(af, bf)	(!((af) < (bf)))
+#define snek_float_le(af, bf)	(!((bf) < (af)))
+
+#ifdef SNEK_QUICKEN
+/*
+ * Binary operators with float operands are rewritten in place to a
+ * float-only form which skips the type dispatch in snek_binary. The
+ * quick forms check their operands and go back through snek_binary
+ * when they aren't both floats, so a quickened op is never wrong,
+ * only slower.
+ */
+static inline snek_op_t
+snek_op_quick(snek_op_t op)
+{
+	if (op <= snek_op_le)
+		return op - snek_op_eq + snek_op_eq_f;
+	if (snek_op_plus <= op && op <= snek_op_divide)
+		return op - snek_op_plus + snek_op_plus_f;
+	return snek_op_nop;
+}
+
+static inline snek_op_t
+snek_op_unquick(snek_op_t op)
+{
+	if (op >= snek_op_eq_f)
+		return op - snek_op_eq_f + snek_op_eq;
+	return op - snek_op_plus_f + snek_op_plus;
+}
+
+#define snek_quick(expr) do {						\
+		snek_poly_t l = snek_pick(0);				\
+		if (snek_is_float(l) && snek_is_float(a)) {		\
+			float af = l.f, bf = a.f;			\
+			a = (expr);					\
+			snek_drop(1);					\
+			snek_next();					\
+		}							\
+		op = snek_op_unquick(op);				\
+		goto binary;						\
+	} while (0)
+
+#define snek_quick_cmp(expr) snek_quick((expr) ? SNEK_ONE : SNEK_ZERO)
+#define snek_quick_float(expr) snek_quick(snek_float_to_poly(expr))
+#endif
+
+#ifdef SNEK_FUSE
+/*
+ * Superinstructions built by snek_code_finish. An int immediate
+ * and a binary operator; the immediate is always a float, so only
+ * the left operand needs checking before skipping snek_binary.
+ */
+#define snek_binary_int(generic, expr) do {				\
+		float bf = (int8_t) code[ip++];				\
+		snek_poly_t l = snek_pick(0);				\
+		if (snek_is_float(l)) {					\
+			float af = l.f;					\
+			a = (expr);					\
+			snek_drop(1);					\
+			snek_next();					\
+		}							\
+		snek_exec_binary(l, generic, snek_float_to_poly(bf));	\
+		snek_drop(1);						\
+		snek_next_check();					\
+	} while (0)
+
+#define snek_binary_int_cmp(generic, expr) snek_binary_int(generic, (expr) ? SNEK_ONE : SNEK_ZERO)
+#define snek_binary_int_float(generic, expr) snek_binary_int(generic, snek_float_to_poly(expr))
+
+/* A comparison followed by branch_false */
+#define snek_compare_branch(generic, expr) do {			\
+		snek_poly_t l = snek_pick(0);				\
+		if (snek_is_float(l) && snek_is_float(a)) {		\
+			float af = l.f, bf = a.f;			\
+			a = (expr) ? SNEK_ONE : SNEK_ZERO;		\
+		} else {						\
+			snek_exec_binary(l, generic, a);		\
+			if (snek_abort)					\
+				goto abort;				\
+		}							\
+		snek_drop(1);						\
+		if (!snek_poly_true(a)) {				\
+			memcpy(&o, &code[ip], sizeof (snek_offset_t));	\
+			snek_branch(o);					\
+		}							\
+		ip += sizeof (snek_offset_t);				\
+		snek_next();						\
+	} while (0)
+#endif
+
 /*
  * Execute code.
  *
@@ -736,146 +950,363 @@ snek_exec(snek_code_t *code_in)
 	snek_offset_t	ip = 0;
 	snek_offset_t	o;
 	snek_offset_t	saved_stackp = snek_stackp;
+	snek_poly_t	a;
+	snek_offset_t	sp;
+	uint8_t		*code;
+	bool		more;
+
+	a = snek_a;
+	sp = snek_stackp;
+
+#ifdef SNEK_EXEC_THREADED
+	static const void * const snek_exec_ops[] = {
+		[snek_op_eq] = &&label_snek_op_eq,
+		[snek_op_ne] = &&label_snek_op_ne,
+		[snek_op_gt] = &&label_snek_op_gt,
+		[snek_op_lt] = &&label_snek_op_lt,
+		[snek_op_ge] = &&label_snek_op_ge,
+		[snek_op_le] = &&label_snek_op_le,
+		[snek_op_chain_eq] = &&label_snek_op_chain_eq,
+		[snek_op_chain_ne] = &&label_snek_op_chain_ne,
+		[snek_op_chain_gt] = &&label_snek_op_chain_gt,
+		[snek_op_chain_lt] = &&label_snek_op_chain_lt,
+		[snek_op_chain_ge] = &&label_snek_op_chain_ge,
+		[snek_op_chain_le] = &&label_snek_op_chain_le,
+		[snek_op_is] = &&label_snek_op_is,
+		[snek_op_is_not] = &&label_snek_op_is_not,
+		[snek_op_in] = &&label_snek_op_in,
+		[snek_op_not_in] = &&label_snek_op_not_in,
+		[snek_op_array] = &&label_snek_op_array,
+		[snek_op_plus] = &&label_snek_op_plus,
+		[snek_op_minus] = &&label_snek_op_minus,
+		[snek_op_times] = &&label_snek_op_times,
+		[snek_op_divide] = &&label_snek_op_divide,
+		[snek_op_div] = &&label_snek_op_div,
+		[snek_op_mod] = &&label_snek_op_mod,
+		[snek_op_pow] = &&label_snek_op_pow,
+		[snek_op_land] = &&label_snek_op_land,
+		[snek_op_lor] = &&label_snek_op_lor,
+		[snek_op_lxor] = &&label_snek_op_lxor,
+		[snek_op_lshift] = &&label_snek_op_lshift,
+		[snek_op_rshift] = &&label_snek_op_rshift,
+		[snek_op_assign_plus] = &&label_snek_op_assign_plus,
+		[snek_op_assign_minus] = &&label_snek_op_assign_minus,
+		[snek_op_assign_times] = &&label_snek_op_assign_times,
+		[snek_op_assign_divide] = &&label_snek_op_assign_divide,
+		[snek_op_assign_div] = &&label_snek_op_assign_div,
+		[snek_op_assign_mod] = &&label_snek_op_assign_mod,
+		[snek_op_assign_pow] = &&label_snek_op_assign_pow,
+		[snek_op_assign_land] = &&label_snek_op_assign_land,
+		[snek_op_assign_lor] = &&label_snek_op_assign_lor,
+		[snek_op_assign_lxor] = &&label_snek_op_assign_lxor,
+		[snek_op_assign_lshift] = &&label_snek_op_assign_lshift,
+		[snek_op_assign_rshift] = &&label_snek_op_assign_rshift,
+		[snek_op_assign] = &&label_snek_op_assign,
+		[snek_op_assign_named] = &&label_snek_op_assign_named,
+		[snek_op_num] = &&label_snek_op_num,
+		[snek_op_int] = &&label_snek_op_int,
+		[snek_op_string] = &&label_snek_op_string,
+		[snek_op_list] = &&label_snek_op_list,
+		[snek_op_tuple] = &&label_snek_op_tuple,
+#ifndef SNEK_NO_DICT
+		[snek_op_dict] = &&label_snek_op_dict,
+#endif
+		[snek_op_id] = &&label_snek_op_id,
+#ifdef SNEK_LOCAL_SLOTS
+		[snek_op_local] = &&label_snek_op_local,
+		[snek_op_assign_local] = &&label_snek_op_assign_local,
+#endif
+		[snek_op_not] = &&label_snek_op_not,
+		[snek_op_uminus] = &&label_snek_op_uminus,
+		[snek_op_lnot] = &&label_snek_op_lnot,
+		[snek_op_call] = &&label_snek_op_call,
+		[snek_op_slice] = &&label_snek_op_slice,
+		[snek_op_global] = &&label_snek_op_global,
+		[snek_op_del] = &&label_snek_op_del,
+		[snek_op_assert] = &&label_snek_op_assert,
+		[snek_op_branch] = &&label_snek_op_branch,
+		[snek_op_branch_true] = &&label_snek_op_branch_true,
+		[snek_op_branch_false] = &&label_snek_op_branch_false,
+		[snek_op_forward] = &&label_snek_op_forward,
+		[snek_op_range_start] = &&label_snek_op_range_start,
+		[snek_op_range_step] = &&label_snek_op_range_step,
+		[snek_op_range_break] = &&label_snek_op_range_break,
+		[snek_op_range_drop] = &&label_snek_op_range_drop,
+		[snek_op_in_step] = &&label_snek_op_in_step,
+		[snek_op_return] = &&label_snek_op_return,
+		[snek_op_line] = &&label_snek_op_line,
+		[snek_op_null] = &&label_snek_op_null,
+		[snek_op_nop] = &&label_snek_op_nop,
+#ifdef SNEK_QUICKEN
+		[snek_op_plus_f] = &&label_snek_op_plus_f,
+		[snek_op_minus_f] = &&label_snek_op_minus_f,
+		[snek_op_times_f] = &&label_snek_op_times_f,
+		[snek_op_divide_f] = &&label_snek_op_divide_f,
+		[snek_op_eq_f] = &&label_snek_op_eq_f,
+		[snek_op_ne_f] = &&label_snek_op_ne_f,
+		[snek_op_gt_f] = &&label_snek_op_gt_f,
+		[snek_op_lt_f] = &&label_snek_op_lt_f,
+		[snek_op_ge_f] = &&label_snek_op_ge_f,
+		[snek_op_le_f] = &&label_snek_op_le_f,
+#endif
+#ifdef SNEK_FUSE
+		[snek_op_plus_i] = &&label_snek_op_plus_i,
+		[snek_op_minus_i] = &&label_snek_op_minus_i,
+		[snek_op_times_i] = &&label_snek_op_times_i,
+		[snek_op_eq_i] = &&label_snek_op_eq_i,
+		[snek_op_ne_i] = &&label_snek_op_ne_i,
+		[snek_op_gt_i] = &&label_snek_op_gt_i,
+		[snek_op_lt_i] = &&label_snek_op_lt_i,
+		[snek_op_ge_i] = &&label_snek_op_ge_i,
+		[snek_op_le_i] = &&label_snek_op_le_i,
+		[snek_op_eq_branch_false] = &&label_snek_op_eq_branch_false,
+		[snek_op_ne_branch_false] = &&label_snek_op_ne_branch_false,
+		[snek_op_gt_branch_false] = &&label_snek_op_gt_branch_false,
+		[snek_op_lt_branch_false] = &&label_snek_op_lt_branch_false,
+		[snek_op_ge_branch_false] = &&label_snek_op_ge_branch_false,
+		[snek_op_le_branch_false] = &&label_snek_op_le_branch_false,
+#endif
+	};
+#endif
 
 	/* Ending the top level code block will clear 'snek_code' to
 	 * indicate completion
 	 */
 	while (snek_code) {
+		snek_fill_code();
 
 		/* Execute all of the instructions in the current code
 		 * block
 		 */
 		while (ip < snek_code->size) {
-#ifdef DEBUG_EXEC
-			snek_code_dump_instruction(snek_code, ip);
-#endif
+			snek_exec_dump(ip);
+			snek_exec_at(ip);
+
 			/* Pull out the next op code, note whether the
 			 * 'push' flag is set and then figure out what
 			 * to do
 			 */
-			snek_op_t op = snek_code->code[ip++];
+			snek_op_t op = code[ip++];
 			bool push = (op & snek_op_push) != 0;
 			op &= ~snek_op_push;
 
 			switch(op) {
-			case snek_op_chain_eq:
-			case snek_op_chain_ne:
-			case snek_op_chain_gt:
-			case snek_op_chain_lt:
-			case snek_op_chain_ge:
-			case snek_op_chain_le:
+			snek_case(snek_op_chain_eq):
+			snek_case(snek_op_chain_ne):
+			snek_case(snek_op_chain_gt):
+			snek_case(snek_op_chain_lt):
+			snek_case(snek_op_chain_ge):
+			snek_case(snek_op_chain_le):
 				op -= (snek_op_chain_eq - snek_op_eq);
-				snek_poly_t r = snek_binary(snek_stack_pick(0), op, snek_a, false);
+				snek_spill();
+				snek_poly_t r = snek_binary(snek_pick(0), op, a, false);
+				snek_fill();
 				if (!snek_poly_true(r)) {
-					snek_a = r;
-					memcpy(&ip, &snek_code->code[ip], sizeof (snek_offset_t));
+					a = r;
+					memcpy(&ip, &code[ip], sizeof (snek_offset_t));
 				} else
 					ip += sizeof (snek_offset_t);
-				break;
-			case snek_op_eq:
-			case snek_op_ne:
-			case snek_op_gt:
-			case snek_op_lt:
-			case snek_op_ge:
-			case snek_op_le:
-
-			case snek_op_is:
-			case snek_op_is_not:
-			case snek_op_in:
-			case snek_op_not_in:
-
-			case snek_op_array:
-
-			case snek_op_plus:
-			case snek_op_minus:
-			case snek_op_times:
-			case snek_op_divide:
-			case snek_op_div:
-			case snek_op_mod:
-			case snek_op_pow:
-			case snek_op_land:
-			case snek_op_lor:
-			case snek_op_lxor:
-			case snek_op_lshift:
-			case snek_op_rshift:
-				snek_a = snek_binary(snek_stack_pick(0), op, snek_a, false);
-				snek_stack_drop(1);
-				break;
+				snek_next_check();
+			snek_case(snek_op_eq):
+			snek_case(snek_op_ne):
+			snek_case(snek_op_gt):
+			snek_case(snek_op_lt):
+			snek_case(snek_op_ge):
+			snek_case(snek_op_le):
+
+			snek_case(snek_op_is):
+			snek_case(snek_op_is_not):
+			snek_case(snek_op_in):
+			snek_case(snek_op_not_in):
+
+			snek_case(snek_op_array):
+
+			snek_case(snek_op_plus):
+			snek_case(snek_op_minus):
+			snek_case(snek_op_times):
+			snek_case(snek_op_divide):
+			snek_case(snek_op_div):
+			snek_case(snek_op_mod):
+			snek_case(snek_op_pow):
+			snek_case(snek_op_land):
+			snek_case(snek_op_lor):
+			snek_case(snek_op_lxor):
+			snek_case(snek_op_lshift):
+			snek_case(snek_op_rshift):
+#ifdef SNEK_QUICKEN
+				if (snek_is_float(a) && snek_is_float(snek_pick(0))) {
+					snek_op_t quick = snek_op_quick(op);
+					/* Code in the read-only region can't be rewritten */
+					if (quick != snek_op_nop && !snek_is_rom_addr(code))
+						code[ip - 1] = quick | (push ? snek_op_push : 0);
+				}
+			binary:
+#endif
+				snek_exec_binary(snek_pick(0), op, a);
+				snek_drop(1);
+				snek_next_check();
+
+#ifdef SNEK_QUICKEN
+			snek_case(snek_op_plus_f):
+				snek_quick_float(af + bf);
+			snek_case(snek_op_minus_f):
+				snek_quick_float(af - bf);
+			snek_case(snek_op_times_f):
+				snek_quick_float(af * bf);
+			snek_case(snek_op_divide_f):
+				snek_quick_float(af / bf);
+			snek_case(snek_op_eq_f):
+				snek_quick_cmp(snek_float_eq(af, bf));
+			snek_case(snek_op_ne_f):
+				snek_quick_cmp(snek_float_ne(af, bf));
+			snek_case(snek_op_gt_f):
+				snek_quick_cmp(snek_float_gt(af, bf));
+			snek_case(snek_op_lt_f):
+				snek_quick_cmp(snek_float_lt(af, bf));
+			snek_case(snek_op_ge_f):
+				snek_quick_cmp(snek_float_ge(af, bf));
+			snek_case(snek_op_le_f):
+				snek_quick_cmp(snek_float_le(af, bf));
+#endif
+
+#ifdef SNEK_FUSE
+			snek_case(snek_op_plus_i):
+				snek_binary_int_float(snek_op_plus, af + bf);
+			snek_case(snek_op_minus_i):
+				snek_binary_int_float(snek_op_minus, af - bf);
+			snek_case(snek_op_times_i):
+				snek_binary_int_float(snek_op_times, af * bf);
+			snek_case(snek_op_eq_i):
+				snek_binary_int_cmp(snek_op_eq, snek_float_eq(af, bf));
+			snek_case(snek_op_ne_i):
+				snek_binary_int_cmp(snek_op_ne, snek_float_ne(af, bf));
+			snek_case(snek_op_gt_i):
+				snek_binary_int_cmp(snek_op_gt, snek_float_gt(af, bf));
+			snek_case(snek_op_lt_i):
+				snek_binary_int_cmp(snek_op_lt, snek_float_lt(af, bf));
+			snek_case(snek_op_ge_i):
+				snek_binary_int_cmp(snek_op_ge, snek_float_ge(af, bf));
+			snek_case(snek_op_le_i):
+				snek_binary_int_cmp(snek_op_le, snek_float_le(af, bf));
+			snek_case(snek_op_eq_branch_false):
+				snek_compare_branch(snek_op_eq, snek_float_eq(af, bf));
+			snek_case(snek_op_ne_branch_false):
+				snek_compare_branch(snek_op_ne, snek_float_ne(af, bf));
+			snek_case(snek_op_gt_branch_false):
+				snek_compare_branch(snek_op_gt, snek_float_gt(af, bf));
+			snek_case(snek_op_lt_branch_false):
+				snek_compare_branch(snek_op_lt, snek_float_lt(af, bf));
+			snek_case(snek_op_ge_branch_false):
+				snek_compare_branch(snek_op_ge, snek_float_ge(af, bf));
+			snek_case(snek_op_le_branch_false):
+				snek_compare_branch(snek_op_le, snek_float_le(af, bf));
+#endif
 
-			case snek_op_assign_plus:
-			case snek_op_assign_minus:
-			case snek_op_assign_times:
-			case snek_op_assign_divide:
-			case snek_op_assign_div:
-			case snek_op_assign_mod:
-			case snek_op_assign_pow:
-			case snek_op_assign_land:
-			case snek_op_assign_lor:
-			case snek_op_assign_lxor:
-			case snek_op_assign_lshift:
-			case snek_op_assign_rshift:
-
-			case snek_op_assign:
-			case snek_op_assign_named:
-				memcpy(&id, &snek_code->code[ip], sizeof (snek_id_t));
+			snek_case(snek_op_assign_plus):
+			snek_case(snek_op_assign_minus):
+			snek_case(snek_op_assign_times):
+			snek_case(snek_op_assign_divide):
+			snek_case(snek_op_assign_div):
+			snek_case(snek_op_assign_mod):
+			snek_case(snek_op_assign_pow):
+			snek_case(snek_op_assign_land):
+			snek_case(snek_op_assign_lor):
+			snek_case(snek_op_assign_lxor):
+			snek_case(snek_op_assign_lshift):
+			snek_case(snek_op_assign_rshift):
+
+			snek_case(snek_op_assign):
+			snek_case(snek_op_assign_named):
+				memcpy(&id, &code[ip], sizeof (snek_id_t));
+				snek_spill();
+				snek_assign(id, op, ip);
+				snek_fill();
 				ip += sizeof (snek_id_t);
-				snek_assign(id, op);
-				break;
+				snek_next_check();
 
-			case snek_op_num:
-				memcpy(&snek_a.f, &snek_code->code[ip], sizeof(float));
+			snek_case(snek_op_num):
+				memcpy(&a.f, &code[ip], sizeof(float));
 				ip += sizeof(float);
-				break;
-			case snek_op_int:
-				snek_a.f = (int8_t) snek_code->code[ip];
+				snek_next();
+			snek_case(snek_op_int):
+				a.f = (int8_t) code[ip];
 				ip += 1;
-				break;
-			case snek_op_string:
-				memcpy(&o, &snek_code->code[ip], sizeof(snek_offset_t));
+				snek_next();
+			snek_case(snek_op_string):
+				memcpy(&o, &code[ip], sizeof(snek_offset_t));
 				ip += sizeof (snek_offset_t);
-				snek_a = snek_offset_to_poly(o, snek_string);
-				break;
-			case snek_op_list:
-			case snek_op_tuple:
+				a = snek_offset_to_poly(o, snek_string);
+				snek_next();
+			snek_case(snek_op_list):
+			snek_case(snek_op_tuple):
 #ifndef SNEK_NO_DICT
-			case snek_op_dict:
+			snek_case(snek_op_dict):
 #endif
-				memcpy(&o, &snek_code->code[ip], sizeof(snek_offset_t));
+				memcpy(&o, &code[ip], sizeof(snek_offset_t));
 				ip += sizeof (snek_offset_t);
+				snek_spill();
 				snek_a = snek_list_imm(o, op - snek_op_list);
-				break;
-			case snek_op_id:
-				memcpy(&id, &snek_code->code[ip], sizeof(snek_id_t));
+				snek_fill();
+				snek_next_check();
+#ifdef SNEK_LOCAL_SLOTS
+			snek_case(snek_op_local):
+				memcpy(&id, &code[ip], sizeof(snek_id_t));
 				ip += sizeof (snek_id_t);
+				a = snek_frame->variables[id].value;
+				if (!snek_is_invalid(a))
+					snek_next();
+
+				/* Not yet assigned, look for a global */
+				id = snek_frame->variables[id].id;
+				snek_spill();
 				ref = snek_id_ref(id, false);
+				snek_fill();
+				goto have_ref;
+			snek_case(snek_op_assign_local):
+				memcpy(&id, &code[ip], sizeof(snek_id_t));
+				ip += sizeof (snek_id_t);
+				snek_frame->variables[id].value = a;
+				snek_next();
+#endif
+			snek_case(snek_op_id):
+				memcpy(&id, &code[ip], sizeof(snek_id_t));
+
+				/* The first lookup may create the global frame */
+				snek_spill();
+				ref = snek_id_ref_ip(id, false, ip);
+				snek_fill();
+				ip += sizeof (snek_id_t);
+#ifdef SNEK_LOCAL_SLOTS
+			have_ref:
+#endif
 
 				/* Allow re-definition of builtin names by looking
 				 * to see if there is a value in the frame before
 				 * checking for a builtin definition
 				 */
 				if (ref) {
-					snek_a = *ref;
-					break;
+					a = *ref;
+					snek_next();
 				}
 				if (id < SNEK_BUILTIN_MAX_BUILTIN) {
-					snek_a = snek_builtin_id_to_poly(id);
-					break;
+					a = snek_builtin_id_to_poly(id);
+					snek_next();
 				}
 				snek_undefined(id);
-				break;
-			case snek_op_not:
-				snek_a = snek_bool_to_poly(!snek_poly_true(snek_a));
-				break;
-			case snek_op_uminus:
-				snek_a = snek_float_to_poly(-snek_poly_get_float(snek_a));
-				break;
-			case snek_op_lnot:
-				snek_a = snek_float_to_poly(~(uint32_t) snek_float_to_int(snek_poly_get_float(snek_a)));
-				break;
-			case snek_op_call:
+				snek_next_check();
+			snek_case(snek_op_not):
+				a = snek_bool_to_poly(!snek_poly_true(a));
+				snek_next();
+			snek_case(snek_op_uminus):
+				a = snek_float_to_poly(-snek_poly_get_float(a));
+				snek_next_check();
+			snek_case(snek_op_lnot):
+				a = snek_float_to_poly(~(uint32_t) snek_float_to_int(snek_poly_get_float(a)));
+				snek_next_check();
+			snek_case(snek_op_call):
 
 				/* find out how many positional and named actuals were provided */
-				memcpy(&o, &snek_code->code[ip], sizeof (snek_offset_t));
+				memcpy(&o, &code[ip], sizeof (snek_offset_t));
 				snek_offset_t nposition = (o & 0xff);
 				snek_offset_t nnamed = (o >> 8);
 
@@ -884,12 +1315,14 @@ snek_exec(snek_code_t *code_in)
 				 */
 				snek_offset_t nstack = nposition + (nnamed<<1);
 
-				/* Go load the function value off the stack. snek_a isn't
-				 * used for function calls, so we can save it here
+				/* Go load the function value off the stack. The
+				 * accumulator isn't used for function calls, so we
+				 * can save it here
 				 */
-				snek_a = snek_stack_pick(nstack);
+				a = snek_pick(nstack);
+				snek_spill();
 
-				switch (snek_poly_type(snek_a)) {
+				switch (snek_poly_type(a)) {
 				case snek_func:
 
 					/* Arrange for the code in the function to run
@@ -897,135 +1330,159 @@ snek_exec(snek_code_t *code_in)
 					 */
 					if (!snek_func_push(nposition, nnamed, ip - 1))
 						break;
-					snek_a = snek_stack_pop();	/* get function back */
+					snek_fill();
+					a = snek_stack[--sp];	/* get function back */
 
 					/* Set our current code pointer and ip to point at the
-					 * function's code
+					 * function's code, skipping ip and stack adjustment
 					 */
-					snek_code = snek_pool_addr(snek_poly_to_func(snek_a)->code);
+					snek_code = snek_pool_addr(snek_poly_to_func(a)->code);
+					snek_fill_code();
 					ip = 0;
 					push = false;	/* will pick up push on return */
-					goto done_func;	/* skip ip and stack adjustment */
+					snek_next_check();
 				case snek_builtin:
 
 					/* Call the builtin function */
-					snek_call_builtin(snek_poly_to_builtin(snek_a), nposition, nnamed);
+					snek_call_builtin(snek_poly_to_builtin(a), nposition, nnamed);
 					break;
 				default:
-					snek_error_type_1(snek_a);
+					snek_error_type_1(a);
 					break;
 				}
+				snek_fill();
+
 				/* Skip the parameter count in the bytecode */
 				ip += sizeof (snek_offset_t);
 
 				/* Drop all actuals */
-				snek_stack_drop(nstack + 1);
-			done_func:
-				break;
-			case snek_op_slice:
+				snek_drop(nstack + 1);
+				snek_next_check();
+			snek_case(snek_op_slice):
 #ifdef SNEK_NO_SLICE
 				snek_error_0("No slices");
 #else
-				snek_slice(snek_code->code[ip]);
+				snek_spill();
+				snek_slice(code[ip]);
+				snek_fill();
 #endif
 				ip++;
-				break;
-			case snek_op_global:
-				memcpy(&id, &snek_code->code[ip], sizeof (snek_id_t));
+				snek_next_check();
+			snek_case(snek_op_global):
+				memcpy(&id, &code[ip], sizeof (snek_id_t));
 				ip += sizeof (snek_id_t);
+				snek_spill();
 				snek_frame_mark_global(id);
-				break;
-			case snek_op_del:
-				memcpy(&id, &snek_code->code[ip], sizeof (snek_id_t));
+				snek_fill();
+				snek_next_check();
+			snek_case(snek_op_del):
+				memcpy(&id, &code[ip], sizeof (snek_id_t));
 				ip += sizeof (snek_id_t);
 
 				if (id == SNEK_ID_NONE) {
 
 					/* Delete an element from a list/dictionary */
-					snek_poly_t lp = snek_stack_pop();
+					snek_poly_t lp = snek_stack[--sp];
 					if (snek_poly_type(lp) != snek_list) {
 						snek_error_type_1(lp);
 					} else {
-						snek_list_del(lp, snek_a);
-						snek_a = SNEK_NULL;
+						snek_spill();
+						snek_list_del(lp, a);
+						snek_fill();
+						a = SNEK_NULL;
 					}
 				} else {
 
 					/* Delete a name from the current scope */
+					snek_spill();
 					snek_id_del(id);
+					snek_fill();
 				}
-				break;
-			case snek_op_return:
+				snek_next_check();
+			snek_case(snek_op_return):
 
 				/* jump to the end of the current code block */
 				ip = snek_code->size;
-				break;
-			case snek_op_assert:
-				if (!snek_poly_true(snek_a)) {
+				snek_next();
+			snek_case(snek_op_assert):
+				if (!snek_poly_true(a)) {
 					snek_error_0("AssertionError");
 				}
-				snek_a = SNEK_NULL;
-				break;
-			case snek_op_branch:
-				memcpy(&ip, &snek_code->code[ip], sizeof (snek_offset_t));
-				break;
-			case snek_op_branch_true:
-				if (snek_poly_true(snek_a))
-					memcpy(&ip, &snek_code->code[ip], sizeof (snek_offset_t));
-				else
-					ip += sizeof (snek_offset_t);
-				break;
-			case snek_op_branch_false:
-				if (!snek_poly_true(snek_a))
-					memcpy(&ip, &snek_code->code[ip], sizeof (snek_offset_t));
-				else
-					ip += sizeof (snek_offset_t);
-				break;
-			case snek_op_forward:
+				a = SNEK_NULL;
+				snek_next_check();
+			snek_case(snek_op_branch):
+				memcpy(&o, &code[ip], sizeof (snek_offset_t));
+				snek_branch(o);
+			snek_case(snek_op_branch_true):
+				if (snek_poly_true(a)) {
+					memcpy(&o, &code[ip], sizeof (snek_offset_t));
+					snek_branch(o);
+				}
+				ip += sizeof (snek_offset_t);
+				snek_next();
+			snek_case(snek_op_branch_false):
+				if (!snek_poly_true(a)) {
+					memcpy(&o, &code[ip], sizeof (snek_offset_t));
+					snek_branch(o);
+				}
+				ip += sizeof (snek_offset_t);
+				snek_next();
+			snek_case(snek_op_forward):
 				snek_error_0("not in loop");
-				break;
-			case snek_op_range_start:
+				snek_next_check();
+			snek_case(snek_op_range_start):
+				snek_spill();
 				snek_range_start(ip);
+				snek_fill();
 				ip += sizeof (snek_offset_t) + sizeof (uint8_t) + sizeof(snek_id_t);
-				break;
-			case snek_op_range_step:
-				if (!snek_range_step(ip))
-					memcpy(&ip, &snek_code->code[ip], sizeof (snek_offset_t));
+				snek_next_check();
+			snek_case(snek_op_range_step):
+				snek_spill();
+				more = snek_range_step(ip);
+				snek_fill();
+				if (!more)
+					memcpy(&ip, &code[ip], sizeof (snek_offset_t));
 				else
 					ip += sizeof (snek_offset_t) + sizeof (uint8_t) + sizeof(snek_id_t);
-				break;
-			case snek_op_in_step:
-				if (!snek_in_step(ip))
-					memcpy(&ip, &snek_code->code[ip], sizeof (snek_offset_t));
+				snek_next_check();
+			snek_case(snek_op_range_break):
+				snek_drop(SNEK_RANGE_STATE);
+				memcpy(&o, &code[ip], sizeof (snek_offset_t));
+				snek_branch(o);
+			snek_case(snek_op_range_drop):
+				snek_drop(SNEK_RANGE_STATE);
+				snek_next();
+			snek_case(snek_op_in_step):
+				snek_spill();
+				more = snek_in_step(ip);
+				snek_fill();
+				if (!more)
+					memcpy(&ip, &code[ip], sizeof (snek_offset_t));
 				else
 					ip += sizeof (snek_offset_t) + sizeof (uint8_t) + sizeof (snek_id_t);
-				break;
-			case snek_op_line:
-				memcpy(&o, &snek_code->code[ip], sizeof (snek_offset_t));
+				snek_next_check();
+			snek_case(snek_op_line):
+				memcpy(&o, &code[ip], sizeof (snek_offset_t));
 				ip += sizeof (snek_offset_t);
 				snek_line = o;
-				break;
-			case snek_op_null:
-				snek_a = SNEK_NULL;
-				break;
-			case snek_op_nop:
+				snek_next();
+			snek_case(snek_op_null):
+				a = SNEK_NULL;
+				snek_next();
+			snek_case(snek_op_nop):
 			case snek_op_push:
-				break;
+				snek_next();
 			}
-			if (snek_abort)
-				goto abort;
+#ifndef SNEK_EXEC_THREADED
+		next:
 			if (push)
-				snek_stack_push(snek_a);
-#ifdef DEBUG_EXEC
-			fprintf(stderr, "\t\ta= ");
-			snek_poly_print(stderr, snek_a, 'r');
-			for (o = snek_stackp; o;) {
-				fprintf(stderr, ", [%d]= ", snek_stackp - o);
-				snek_poly_print(stderr, snek_stack[--o], 'r');
-			}
-			fprintf(stderr, "\n");
+				snek_push();
+			snek_exec_trace();
 #endif
 		}
+#ifdef SNEK_EXEC_THREADED
+	code_done:
+#endif
 
 		/* Done with current code block. Pop the current frame and
 		 * use the ip value saved there
@@ -1033,13 +1490,14 @@ snek_exec(snek_code_t *code_in)
 		ip = snek_frame_pop();
 
 		if (snek_code) {
+			snek_fill_code();
 
 			/* If we have another frame, push the accumulator if desired
 			 * and step over the call instruction
 			 */
-			snek_op_t op = snek_code->code[ip];
+			snek_op_t op = code[ip];
 			if ((op & snek_op_push) != 0)
-				snek_stack_push(snek_a);
+				snek_push();
 			ip += sizeof (snek_offset_t) + 1;
 		}
 	}
@@ -1048,7 +1506,10 @@ abort:
 	snek_code = NULL;
 	snek_frame = NULL;
 	snek_stackp = saved_stackp;
-	snek_poly_t ret = snek_a;
 	snek_a = SNEK_NULL;
-	return ret;
+	return a;
+
+overflow:
+	snek_error_0("stack overflow");
+	goto abort;
 }
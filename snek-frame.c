@@ -17,6 +17,124 @@
 snek_frame_t	*snek_globals;
 snek_frame_t	*snek_frame;
 
+#ifdef SNEK_GLOBALS_HASH
+
+/*
+ * The global frame is allocated with spare variable slots and
+ * followed by an open-addressed index mapping ids to slots. The
+ * index holds slot numbers rather than pool offsets, so moving the
+ * frame during compaction leaves it valid.
+ */
+
+#define SNEK_GLOBALS_MIN	8
+
+static snek_offset_t
+snek_globals_nindex(snek_offset_t nalloc)
+{
+	return nalloc << 1;
+}
+
+static snek_offset_t
+snek_globals_size(snek_offset_t nalloc)
+{
+	return sizeof (snek_frame_t) + nalloc * sizeof (snek_variable_t) +
+		snek_globals_nindex(nalloc) * sizeof (snek_offset_t);
+}
+
+static snek_offset_t *
+snek_globals_index(snek_frame_t *frame)
+{
+	return (snek_offset_t *) &frame->variables[frame->nalloc];
+}
+
+static void
+snek_globals_rehash(snek_frame_t *frame)
+{
+	snek_offset_t	*index = snek_globals_index(frame);
+	snek_offset_t	mask = snek_globals_nindex(frame->nalloc) - 1;
+	snek_offset_t	slot;
+
+	memset(index, '\0', (mask + 1) * sizeof (snek_offset_t));
+	for (slot = 0; slot < frame->nvariables; slot++) {
+		snek_offset_t h = frame->variables[slot].id & mask;
+
+		while (index[h])
+			h = (h + 1) & mask;
+		index[h] = slot + 1;
+	}
+}
+
+static snek_frame_t *
+snek_globals_alloc(snek_offset_t nalloc)
+{
+	snek_frame_t *frame = snek_alloc(snek_globals_size(nalloc));
+
+	if (!frame)
+		return NULL;
+	frame->prev = SNEK_OFFSET_NONE;
+	frame->code = SNEK_OFFSET_NONE;
+	frame->nalloc = nalloc;
+	if (snek_globals) {
+		frame->nvariables = snek_globals->nvariables;
+		memcpy(frame->variables, snek_globals->variables,
+		       frame->nvariables * sizeof (snek_variable_t));
+		snek_globals_rehash(frame);
+	}
+	snek_globals = frame;
+	return frame;
+}
+
+static snek_variable_t *
+snek_globals_lookup(snek_id_t id, bool insert)
+{
+	snek_frame_t	*frame = snek_globals;
+
+	if (!frame && !(frame = snek_globals_alloc(SNEK_GLOBALS_MIN)))
+		return NULL;
+
+	snek_offset_t	*index = snek_globals_index(frame);
+	snek_offset_t	mask = snek_globals_nindex(frame->nalloc) - 1;
+	snek_offset_t	h;
+	snek_offset_t	slot;
+
+	for (h = id & mask; (slot = index[h]); h = (h + 1) & mask)
+		if (frame->variables[slot-1].id == id)
+			return &frame->variables[slot-1];
+
+	if (!insert)
+		return NULL;
+
+	/* Double the capacity when full, keeping growth linear */
+	if (frame->nvariables == frame->nalloc) {
+		frame = snek_globals_alloc(frame->nalloc << 1);
+		if (!frame)
+			return NULL;
+		index = snek_globals_index(frame);
+		mask = snek_globals_nindex(frame->nalloc) - 1;
+		for (h = id & mask; index[h]; h = (h + 1) & mask)
+			;
+	}
+	slot = frame->nvariables++;
+	index[h] = slot + 1;
+	frame->variables[slot].id = id;
+	frame->variables[slot].value = SNEK_ZERO;
+	return &frame->variables[slot];
+}
+
+static void
+snek_variable_delete(snek_offset_t i)
+{
+	snek_frame_t	*frame = snek_globals;
+
+	frame->nvariables--;
+	memmove(&frame->variables[i],
+		&frame->variables[i+1],
+		(frame->nvariables - i) * sizeof (snek_variable_t));
+	snek_globals_rehash(frame);
+}
+
+#endif
+
 static snek_frame_t *snek_pick_frame(bool globals)
 {
 	if (globals) {
@@ -36,11 +154,23 @@ snek_frame_prev(snek_frame_t *frame)
 	return snek_pool_addr(frame->prev);
 }
 
+#ifdef SNEK_ID_CACHE
+static snek_offset_t	snek_frame_serial;
+#define snek_frame_set_serial(frame)	((frame)->serial = ++snek_frame_serial)
+#else
+#define snek_frame_set_serial(frame)
+#endif
+
+static snek_offset_t
+snek_frame_bytes(snek_offset_t nvariables)
+{
+	return sizeof (snek_frame_t) + nvariables * sizeof (snek_variable_t);
+}
+
 static snek_frame_t *
 snek_frame_realloc(bool globals, snek_offset_t nvariables)
 {
-	snek_frame_t *frame = snek_alloc(sizeof (snek_frame_t) +
-					 nvariables * sizeof (snek_variable_t));
+	snek_frame_t *frame = snek_alloc(snek_frame_bytes(nvariables));
 
 	if (!frame)
 		return NULL;
@@ -48,6 +178,7 @@ snek_frame_realloc(bool globals, snek_offset_t nvariables)
 	snek_frame_t *old_frame = snek_pick_frame(globals);
 	*frame = *old_frame;
 	frame->nvariables = nvariables;
+	snek_frame_set_serial(frame);
 	return frame;
 }
 
@@ -66,13 +197,16 @@ snek_variable_insert(bool globals)
 	       old_frame->variables,
 	       old_frame->nvariables * sizeof (snek_variable_t));
 
-	if (globals)
+	if (globals) {
 		snek_globals = frame;
-	else
+	} else {
+		snek_free(old_frame, snek_frame_bytes(old_frame->nvariables));
 		snek_frame = frame;
+	}
 	return &frame->variables[nvariables-1];
 }
 
+#ifndef SNEK_GLOBALS_HASH
 static void
 snek_variable_delete(snek_offset_t i)
 {
@@ -84,9 +218,10 @@ snek_variable_delete(snek_offset_t i)
 	       i * sizeof (snek_variable_t));
 	memcpy(&frame->variables[i],
 	       &snek_globals->variables[i+1],
-	       snek_globals->nvariables - i - 1);
+	       (snek_globals->nvariables - i - 1) * sizeof (snek_variable_t));
 	snek_globals = frame;
 }
+#endif
 
 static snek_variable_t *
 snek_variable_lookup(bool globals, snek_id_t id, bool insert)
@@ -94,6 +229,10 @@ snek_variable_lookup(bool globals, snek_id_t id, bool insert)
 	snek_offset_t	i;
 	snek_frame_t	*frame;
 
+#ifdef SNEK_GLOBALS_HASH
+	if (globals)
+		return snek_globals_lookup(id, insert);
+#endif
 	frame = snek_pick_frame(globals);
 	if (!frame)
 		return NULL;
@@ -119,7 +258,8 @@ snek_frame_lookup(snek_id_t id, bool insert)
 	snek_variable_t	*v = NULL;
 
 	if ((v = snek_variable_lookup(false, id, insert))) {
-		if (!snek_is_global(v->value))
+		/* A slot without a value yet only counts when assigning */
+		if (!snek_is_global(v->value) && (insert || !snek_is_invalid(v->value)))
 			return v;
 	}
 	return snek_variable_lookup(true, id, insert);
@@ -142,10 +282,11 @@ snek_frame_push(snek_offset_t ip, snek_offset_t nformal)
 {
 	snek_frame_t *f;
 
-	f = snek_alloc(sizeof (snek_frame_t) + nformal * sizeof (snek_variable_t));
+	f = snek_alloc(snek_frame_bytes(nformal));
 	if (!f)
 		return false;
 	f->nvariables = nformal;
+	snek_frame_set_serial(f);
 	f->code = snek_pool_offset(snek_code);
 	f->ip = ip;
 	f->prev = snek_pool_offset(snek_frame);
@@ -161,10 +302,14 @@ snek_frame_pop(void)
 		return 0;
 	}
 
-	snek_offset_t ip = snek_frame->ip;
+	snek_frame_t *frame = snek_frame;
+	snek_offset_t ip = frame->ip;
+
+	snek_code = snek_pool_addr(frame->code);
+	snek_frame = snek_frame_prev(frame);
 
-	snek_code = snek_pool_addr(snek_frame->code);
-	snek_frame = snek_frame_prev(snek_frame);
+	/* Nothing else refers to a function frame */
+	snek_free(frame, snek_frame_bytes(frame->nvariables));
 
 	return ip;
 }
@@ -178,15 +323,116 @@ snek_id_ref(snek_id_t id, bool insert)
 	return &v->value;
 }
 
+#ifdef SNEK_ID_CACHE
+
+/*
+ * Per-instruction variable cache. Each entry remembers which frame
+ * slot the id referenced by one instruction was found in the last
+ * time it executed. Entries are never explicitly invalidated;
+ * instead, every hit is re-validated by checking that the slot still
+ * holds the same id. That check catches deleted names and
+ * reallocated frames.
+ *
+ * A local hit is complete once the slot matches. A global hit also
+ * depends on the local frame not holding a value for the id, so
+ * those record which local frame was searched and which slot, if
+ * any, names the id without a value. Frames are never resized in
+ * place and each new frame gets a fresh serial number, so a frame
+ * offset paired with that serial names a unique set of local
+ * variables even when the memory is later reused.
+ */
+
+typedef struct snek_id_cache {
+	snek_offset_t	code;
+	snek_offset_t	ip;
+	snek_offset_t	frame;
+	snek_offset_t	serial;
+	snek_offset_t	slot;
+	snek_offset_t	local;
+	bool		global;
+} snek_id_cache_t;
+
+static snek_id_cache_t	snek_id_cache[SNEK_ID_CACHE];
+
+snek_poly_t *
+snek_id_ref_ip(snek_id_t id, bool insert, snek_offset_t ip)
+{
+	snek_offset_t	code = snek_pool_offset(snek_code);
+	snek_id_cache_t	*c = &snek_id_cache[((code >> 2) ^ ip) & (SNEK_ID_CACHE - 1)];
+
+	if (c->code == code && c->ip == ip) {
+		snek_frame_t	*frame = c->global ? snek_globals : snek_frame;
+
+		if (frame && c->slot < frame->nvariables) {
+			snek_variable_t	*v = &frame->variables[c->slot];
+
+			if (v->id == id) {
+				if (!c->global) {
+					if (!snek_is_global(v->value) &&
+					    (insert || !snek_is_invalid(v->value)))
+						return &v->value;
+				} else if (c->frame == snek_pool_offset(snek_frame) &&
+					   (!snek_frame || c->serial == snek_frame->serial))
+				{
+					if (snek_offset_is_none(c->local))
+						return &v->value;
+					snek_poly_t l = snek_frame->variables[c->local].value;
+					if (snek_is_global(l) || (!insert && snek_is_invalid(l)))
+						return &v->value;
+				}
+			}
+		}
+	}
+
+	snek_variable_t	*v = snek_frame_lookup(id, insert);
+	if (!v)
+		return NULL;
+
+	/* Lookup may have allocated, moving everything around */
+	snek_frame_t *frame = snek_frame;
+	bool global = !frame || v < frame->variables || &frame->variables[frame->nvariables] <= v;
+	if (global)
+		frame = snek_globals;
+	code = snek_pool_offset(snek_code);
+	c = &snek_id_cache[((code >> 2) ^ ip) & (SNEK_ID_CACHE - 1)];
+	c->code = code;
+	c->ip = ip;
+	c->global = global;
+	c->local = SNEK_OFFSET_NONE;
+	if (global && snek_frame) {
+		snek_offset_t	l;
+
+		for (l = 0; l < snek_frame->nvariables; l++)
+			if (snek_frame->variables[l].id == id)
+				c->local = l;
+	}
+	c->frame = snek_pool_offset(snek_frame);
+	c->serial = snek_frame ? snek_frame->serial : 0;
+	c->slot = v - frame->variables;
+	return &v->value;
+}
+
+#endif
+
 bool
 snek_id_is_local(snek_id_t id)
 {
-	return snek_variable_lookup(false, id, false) != NULL;
+	snek_variable_t *v = snek_variable_lookup(false, id, false);
+
+	return v && !snek_is_invalid(v->value);
 }
 
 bool
 snek_id_del(snek_id_t id)
 {
+#ifdef SNEK_GLOBALS_HASH
+	snek_variable_t *v = snek_globals_lookup(id, false);
+
+	if (!v)
+		return false;
+	snek_variable_delete(v - snek_globals->variables);
+	return true;
+#else
 	snek_offset_t i;
 
 	for (i = 0; i < snek_globals->nvariables; i++)
@@ -196,6 +442,7 @@ snek_id_del(snek_id_t id)
 		}
 
 	return false;
+#endif
 }
 
 static snek_offset_t
@@ -203,6 +450,11 @@ snek_frame_size(void *addr)
 {
 	snek_frame_t *frame = addr;
 
+#ifdef SNEK_GLOBALS_HASH
+	/* Only the global frame has spare slots and an index */
+	if (frame == snek_globals)
+		return snek_globals_size(frame->nalloc);
+#endif
 	return sizeof (snek_frame_t) + frame->nvariables * sizeof (snek_variable_t);
 }
 
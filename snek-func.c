@@ -16,13 +16,142 @@
 
 snek_code_t		*snek_stash_code;
 
+#ifdef SNEK_LOCAL_SLOTS
+
+/*
+ * Local variables are given fixed frame slots, following the
+ * formals. A local is any name bound by a plain assignment or a for
+ * loop within the function body, unless the function declares it
+ * global. Loads and stores of those names are rewritten to index the
+ * frame directly.
+ */
+
+#define SNEK_MAX_SLOTS	255
+
+/* Find the name bound by one instruction */
+static bool
+snek_func_binds(const uint8_t *insn, snek_id_t *id)
+{
+	const uint8_t	*operand = insn + 1;
+
+	switch (insn[0] & ~snek_op_push) {
+	case snek_op_assign:
+		memcpy(id, operand, sizeof (snek_id_t));
+		return *id != SNEK_ID_NONE;
+	case snek_op_range_start:
+	case snek_op_in_step:
+		memcpy(id, operand + sizeof (snek_offset_t) + sizeof (uint8_t), sizeof (snek_id_t));
+		return true;
+	}
+	return false;
+}
+
+static bool
+snek_func_is_formal(snek_id_t id)
+{
+	uint8_t	f;
+
+	for (f = 0; f < snek_parse_nformal; f++)
+		if (snek_parse_formals[f] == id)
+			return true;
+	return false;
+}
+
+/*
+ * Check whether 'id' is bound as a local by an instruction before
+ * 'stop', or declared global anywhere in the function
+ */
+static bool
+snek_func_seen(snek_code_t *code, snek_offset_t stop, snek_id_t id)
+{
+	snek_offset_t	ip;
+	snek_op_t	op;
+	snek_id_t	bound;
+	snek_id_t	g;
+
+	for (ip = 0; ip < code->size; ip += 1 + snek_op_operand_size(op)) {
+		op = code->code[ip] & ~snek_op_push;
+		if (op == snek_op_global) {
+			memcpy(&g, &code->code[ip + 1], sizeof (snek_id_t));
+			if (g == id)
+				return true;
+		}
+		if (ip < stop && snek_func_binds(&code->code[ip], &bound) && bound == id)
+			return true;
+	}
+	return false;
+}
+
+/*
+ * Walk the function looking for locals. With 'locals' NULL, just
+ * count them
+ */
+static uint8_t
+snek_func_locals(snek_code_t *code, snek_id_t *locals, uint8_t max)
+{
+	snek_offset_t	ip;
+	snek_op_t	op;
+	snek_id_t	id;
+	uint8_t		nlocal = 0;
+
+	for (ip = 0; ip < code->size; ip += 1 + snek_op_operand_size(op)) {
+		op = code->code[ip] & ~snek_op_push;
+		if (nlocal == max || !snek_func_binds(&code->code[ip], &id))
+			continue;
+		if (snek_func_is_formal(id) || snek_func_seen(code, ip, id))
+			continue;
+		if (locals)
+			locals[nlocal] = id;
+		nlocal++;
+	}
+	return nlocal;
+}
+
+/*
+ * Rewrite variable references to use frame slots
+ */
+static void
+snek_func_resolve(snek_func_t *func, snek_code_t *code)
+{
+	snek_offset_t	ip;
+	snek_op_t	op;
+	uint8_t		nslot = snek_func_nslot(func);
+
+	for (ip = 0; ip < code->size; ip += 1 + snek_op_operand_size(op)) {
+		uint8_t		*insn = &code->code[ip];
+		snek_id_t	id;
+		snek_id_t	slot;
+
+		op = *insn & ~snek_op_push;
+		if (op != snek_op_id && op != snek_op_assign)
+			continue;
+		memcpy(&id, insn + 1, sizeof (snek_id_t));
+		if (id == SNEK_ID_NONE)
+			continue;
+		for (slot = 0; slot < nslot; slot++)
+			if (func->formals[slot] == id)
+				break;
+		/* Leave formals declared global alone */
+		if (slot == nslot || (slot < func->nformal && snek_func_seen(code, 0, id)))
+			continue;
+		*insn = (*insn & snek_op_push) | (op == snek_op_id ? snek_op_local : snek_op_assign_local);
+		memcpy(insn + 1, &slot, sizeof (snek_id_t));
+	}
+}
+
+#endif
+
 snek_func_t *
 snek_func_alloc(snek_code_t *code)
 {
-	snek_func_t *func;
+	snek_func_t	*func;
+	uint8_t		nslot = snek_parse_nformal;
 
+#ifdef SNEK_LOCAL_SLOTS
+	nslot += snek_func_locals(code, NULL, SNEK_MAX_SLOTS - nslot);
+#endif
 	snek_stash_code = code;
-	func = snek_alloc(sizeof (snek_func_t) + snek_parse_nformal * sizeof (snek_id_t));
+	func = snek_alloc(sizeof (snek_func_t) + nslot * sizeof (snek_id_t));
 	code = snek_stash_code;
 	snek_stash_code = NULL;
 	if (!func)
@@ -31,47 +160,27 @@ snek_func_alloc(snek_code_t *code)
 	func->nformal = snek_parse_nformal;
 	func->nrequired = snek_parse_nformal - snek_parse_nnamed;
 	memcpy(func->formals, snek_parse_formals, snek_parse_nformal * sizeof (snek_id_t));
+#ifdef SNEK_LOCAL_SLOTS
+	func->nlocal = nslot - func->nformal;
+	snek_func_locals(code, func->formals + func->nformal, func->nlocal);
+	snek_func_resolve(func, code);
+#endif
 	return func;
 }
 
 /*
- * Assign a function formal from an actual value.
- *
- * Check to make sure there aren't duplicate assignments,
- * e.g. a positional actual and named actual that end up
- * naming the same formal.
+ * Find the frame slot for a named actual, returning nformal if there
+ * isn't a matching formal
  */
-static bool __attribute__((noinline))
-snek_func_actual(snek_id_t id, snek_poly_t value, uint8_t pos)
+static uint8_t
+snek_func_formal(snek_id_t id, snek_func_t *func)
 {
-	snek_variable_t *existing = &snek_frame->variables[snek_frame->nvariables-1];
-	snek_variable_t *insert = &snek_frame->variables[pos];
+	uint8_t f;
 
-	/* Check existing formals to see if we're duplicating one of
-	 * those
-	 */
-	while (existing > insert) {
-		if (existing->id == id)
-			return false;
-		existing--;
-	}
-
-	/* All good, assign the name and value in the frame */
-	existing->id = id;
-	existing->value = value;
-	return true;
-}
-
-/*
- * Make sure a named actual matches a known formal
- */
-static bool
-snek_func_check_formal(snek_id_t id, snek_func_t *func)
-{
-	for (uint8_t f = 0; f < func->nformal; f++)
+	for (f = 0; f < func->nformal; f++)
 		if (func->formals[f] == id)
-			return true;
-	return false;
+			break;
+	return f;
 }
 
 /*
@@ -83,11 +192,19 @@ snek_func_push(uint8_t nposition, uint8_t nnamed, snek_offset_t ip)
 	/* Allocate the frame first so that
 	 * nothing moves during the rest of the function
 	 */
-	uint8_t nparam = nposition + nnamed;
-	if (!snek_frame_push(ip, nparam))
+	if (!snek_frame_push(ip, snek_func_nslot(snek_poly_to_func(snek_a))))
 		return false;
 
 	snek_func_t *func = snek_poly_to_func(snek_a);
+	uint8_t pos;
+
+	/* Each formal (and local) has a slot in the frame, in order,
+	 * starting out without a value
+	 */
+	for (pos = 0; pos < snek_frame->nvariables; pos++) {
+		snek_frame->variables[pos].id = func->formals[pos];
+		snek_frame->variables[pos].value = SNEK_INVALID;
+	}
 
 	/* Check to make sure we don't pass more actuals by position
 	 * than there are formals in the function
@@ -97,14 +214,15 @@ snek_func_push(uint8_t nposition, uint8_t nnamed, snek_offset_t ip)
 		goto fail_frame;
 	}
 
-	uint8_t pos = nparam;
+	pos = nposition + nnamed;
 	snek_offset_t save_stackp = snek_stackp;
 	snek_poly_t value;
 	snek_id_t id;
 
 	/* Assign formals from actuals */
 	while (pos) {
-		pos--;
+		uint8_t slot = --pos;
+
 		value = snek_stack_pop();
 
 		if (pos >= nposition) {
@@ -112,21 +230,26 @@ snek_func_push(uint8_t nposition, uint8_t nnamed, snek_offset_t ip)
 			id = snek_stack_pop_soffset();
 
 			/* Make sure the actual matches a formal */
-			if (!snek_func_check_formal(id, func))
+			slot = snek_func_formal(id, func);
+			if (slot == func->nformal)
 				goto fail;
 		} else {
 			/* positional actuals come first */
 			id = func->formals[pos];
 		}
 
-		/* Insert into the frame, checking for duplicates */
-		if (!snek_func_actual(id, value, pos))
+		/* Check for duplicates, e.g. a positional actual and
+		 * named actual that end up naming the same formal
+		 */
+		snek_variable_t *v = &snek_frame->variables[slot];
+		if (!snek_is_invalid(v->value))
 			goto fail;
+		v->value = value;
 	}
 
 	/* Make sure all required formals were given values */
 	for (pos = 0; pos < func->nrequired; pos++)
-		if (!snek_frame->variables[pos].id) {
+		if (snek_is_invalid(snek_frame->variables[pos].value)) {
 			id = func->formals[pos];
 			goto fail;
 		}
@@ -147,7 +270,7 @@ snek_func_size(void *addr)
 {
 	snek_func_t *func = addr;
 
-	return (snek_offset_t) sizeof (snek_func_t) + func->nformal * (snek_offset_t) sizeof (snek_id_t);
+	return (snek_offset_t) sizeof (snek_func_t) + snek_func_nslot(func) * (snek_offset_t) sizeof (snek_id_t);
 }
 
 void
@@ -17,6 +17,13 @@ start		: command @{ snek_parse_middle = false; }@ start
 command		: @{ snek_print_val = snek_interactive; }@ stat
 			@{
 				snek_code_t *code = snek_code_finish();
+#ifdef SNEK_IMAGE
+				if (snek_image_build) {
+					if (code && !snek_image_add_stat(code))
+						return parse_return_error;
+					break;
+				}
+#endif
 				SNEK_CODE_HOOK_START
 				snek_poly_t p = snek_exec(code);
 				SNEK_CODE_HOOK_STOP
@@ -51,6 +58,12 @@ command		: @{ snek_print_val = snek_interactive; }@ stat
 				snek_poly_t	poly = snek_func_to_poly(func);
 				snek_id_t	id = value_pop().id;
 
+#ifdef SNEK_IMAGE
+				if (snek_image_build) {
+					snek_image_add(snek_float_to_poly(id), poly);
+					break;
+				}
+#endif
 				snek_stack_push(poly);
 				snek_poly_t *ref = snek_id_ref(id, true);
 				poly = snek_stack_pop();
@@ -99,7 +112,7 @@ small-stats-p	: SEMI small-stat small-stats-p
 		;
 small-stat	: assign-expr
 		| RETURN ret-expr
-			@{ snek_code_add_op(snek_op_return); }@
+			@{ add_return(); }@
 		| BREAK
 			@{ snek_code_add_forward(snek_forward_break); }@
 		| CONTINUE
@@ -179,10 +192,8 @@ compound-stat	: if-stat
 		;
 if-stat		: IF if-expr suite elif-stats
 			@{
-				snek_offset_t elif_stats_off = value_pop().offset;
-				snek_offset_t if_expr_off = value_pop().offset;
-				snek_code_patch_branch(if_expr_off, elif_stats_off);
-				snek_code_patch_forward(if_expr_off, snek_compile_size,
+				snek_offset_t if_off = patch_if();
+				snek_code_patch_forward(if_off, snek_compile_size,
 							snek_forward_if, snek_code_current());
 			}@
 		;
@@ -195,9 +206,7 @@ elif-stats	: ELIF
 			}@
 		  if-expr suite elif-stats
 			@{
-				snek_offset_t elif_stats_off = value_pop().offset;
-				snek_offset_t if_expr_off = value_pop().offset;
-				snek_code_patch_branch(if_expr_off, elif_stats_off);
+				patch_if();
 			}@
 		| ELSE COLON
 			@
@@ -206,15 +215,20 @@ elif-stats	: ELIF
 		  suite
 		|
 			@{
-				/* push 1 - elif_stats_off */
+				/* push 2 - elif_stats_off */
 				value_push_offset(snek_code_current());
 			}@
 		;
-if-expr		: expr COLON
+if-expr		:
+			@{
+				/* push 0 - if_expr_start */
+				value_push_offset(snek_code_current());
+			}@
+		  expr COLON
 			@{
 				snek_code_add_op_offset(snek_op_branch_false, 0);
 
-				/* push 0 - if_expr_off */
+				/* push 1 - if_expr_off */
 				value_push_offset(snek_compile_prev);
 			}@
 		;
@@ -249,6 +263,8 @@ for-stat	: FOR NAME
 			}@
 		  IN for-params suite
 			@{
+				if (for_is_range())
+					range_depth--;
 				snek_code_add_op_offset(snek_op_branch, 0);
 				/* push 2 - loop_end_off */
 				value_push_offset(snek_compile_prev);
@@ -266,6 +282,7 @@ for-params	: RANGE OP opt-actuals CP COLON
 					return parse_return_syntax;
 				snek_id_t id = value_pop().id;
 				snek_code_add_in_range(id, num, for_depth);
+				range_depth++;
 			for_push_prevs:
 				/* push 0 - for_off */
 				value_push_offset(snek_compile_prev);
@@ -395,7 +412,7 @@ expr-mul-p	: MULOP @ binop_first(); @ expr-unary @ binop_second(); @ expr-mul-p
 		|
 		;
 expr-unary	: LNOT @ unop_first(); @ expr-unary @ unop_second(); @
-		| MINUS @ value_push_op(snek_op_uminus); @ expr-unary @ unop_second(); @
+		| MINUS @ unop_push(snek_op_uminus); @ expr-unary @ unop_second(); @
 		| PLUS expr-unary
 		| expr-pow
 		;
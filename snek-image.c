@@ -0,0 +1,224 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ */
+
+#include "snek.h"
+
+#ifdef SNEK_IMAGE
+
+/*
+ * While building an image, top-level statements are saved instead
+ * of executed. The program list holds them as pairs of entries: a
+ * statement is None followed by a function wrapping its code, and a
+ * function definition is its name id followed by the function.
+ * Running the image replays the list in source order, so names are
+ * bound at the same point they would have been from source.
+ */
+
+bool		snek_image_build;
+snek_list_t	*snek_image_program;
+
+bool
+snek_image_add(snek_poly_t name, snek_poly_t value)
+{
+	snek_stack_push(name);
+	snek_stack_push(value);
+	if (!snek_image_program)
+		snek_image_program = snek_list_make(0, snek_list_list);
+	snek_list_t *program = snek_image_program;
+	if (program)
+		program = snek_list_resize(program, program->size + 2);
+	value = snek_stack_pop();
+	name = snek_stack_pop();
+	if (!program)
+		return false;
+	snek_poly_t *data = snek_list_data(program);
+	data[program->size - 2] = name;
+	data[program->size - 1] = value;
+	return true;
+}
+
+bool
+snek_image_add_stat(snek_code_t *code)
+{
+	snek_stash_code = code;
+	snek_func_t *func = snek_alloc(sizeof (snek_func_t));
+	code = snek_stash_code;
+	snek_stash_code = NULL;
+	if (!func)
+		return false;
+	/* Statements use the global frame, so the function has no slots */
+	func->code = snek_pool_offset(code);
+	return snek_image_add(SNEK_NULL, snek_func_to_poly(func));
+}
+
+#ifdef SNEK_ROM
+/*
+ * While building, code and constant strings are placed in a separate
+ * region which the image loader leaves in place, read-only, instead
+ * of copying into the pool
+ */
+static uint8_t	*snek_rom_build;
+
+void *
+snek_rom_alloc(snek_offset_t size)
+{
+	size = (size + (SNEK_ALLOC_ROUND - 1)) & ~(SNEK_ALLOC_ROUND - 1);
+	if (!snek_rom_build) {
+		snek_rom_build = calloc(SNEK_ROM_MAX, 1);
+		snek_rom = snek_rom_build;
+	}
+	if (!snek_rom_build || SNEK_ROM_MAX - snek_rom_size < size) {
+		snek_error_0("out of memory");
+		return NULL;
+	}
+	void *addr = snek_rom_build + snek_rom_size;
+	snek_rom_size += size;
+	return addr;
+}
+#endif
+
+static uint32_t
+snek_image_features(void)
+{
+	uint32_t features = sizeof (snek_offset_t) | (SNEK_ALLOC_ROUND << 8);
+
+#ifdef SNEK_NO_DICT
+	features |= 1 << 16;
+#endif
+#ifdef SNEK_LOCAL_SLOTS
+	features |= 1 << 17;
+#endif
+#ifdef SNEK_QUICKEN
+	features |= 1 << 18;
+#endif
+#ifdef SNEK_FUSE
+	features |= 1 << 19;
+#endif
+#ifdef SNEK_LINE_TABLE
+	features |= 1 << 20;
+#endif
+#ifdef SNEK_NAME_HASH
+	features |= 1 << 21;
+#endif
+#ifdef SNEK_GLOBALS_HASH
+	features |= 1 << 22;
+#endif
+#ifdef SNEK_ID_CACHE
+	features |= 1 << 23;
+#endif
+#ifdef SNEK_ROM
+	features |= 1 << 24;
+#endif
+#ifdef SNEK_DICT_HASH
+	features |= 1 << 25;
+#endif
+#ifdef SNEK_STRING_LEN
+	features |= 1 << 26;
+#endif
+#ifdef SNEK_STRING_CHARS
+	features |= 1 << 27;
+#endif
+	return features;
+}
+
+/*
+ * Fill in the image header. The image->rom bytes at snek_rom and
+ * then the image->top bytes at snek_pool are saved after it
+ */
+bool
+snek_image_save(snek_image_t *image)
+{
+	memset(image, '\0', sizeof (snek_image_t));
+	snek_frame = NULL;
+	snek_code = NULL;
+	snek_a = SNEK_NULL;
+	snek_stackp = 0;
+	snek_code_reset();
+	image->magic = SNEK_IMAGE_MAGIC;
+	image->version = SNEK_IMAGE_VERSION;
+	image->features = snek_image_features();
+	image->builtin_end = SNEK_BUILTIN_END;
+	image->id = snek_id;
+#ifdef SNEK_ROM
+	image->rom = snek_rom_size;
+#endif
+	return snek_mem_image_save(image);
+}
+
+/*
+ * Replace the heap with an image. 'data' must be aligned for
+ * snek_image_t and, with SNEK_ROM, must stay in place while
+ * snek runs
+ */
+bool
+snek_image_load(const void *data, uint32_t size)
+{
+	const snek_image_t *image = data;
+
+	if (size < sizeof (snek_image_t) ||
+	    image->magic != SNEK_IMAGE_MAGIC ||
+	    image->version != SNEK_IMAGE_VERSION ||
+	    image->features != snek_image_features() ||
+	    image->builtin_end != SNEK_BUILTIN_END ||
+	    size - sizeof (snek_image_t) < image->rom ||
+	    size - sizeof (snek_image_t) - image->rom < image->top)
+		return false;
+#ifdef SNEK_ROM
+	if (image->rom > SNEK_ROM_MAX)
+		return false;
+#endif
+	snek_id_t id = snek_id;
+
+	/* Collecting the new heap needs the number of names */
+	snek_id = image->id;
+	if (!snek_mem_image_load(image)) {
+		snek_id = id;
+		return false;
+	}
+	snek_code_reset();
+	return true;
+}
+
+/*
+ * Execute the statements and bind the functions of a loaded image,
+ * then release the program list
+ */
+bool
+snek_image_run(void)
+{
+	snek_offset_t i;
+
+	for (i = 0; snek_image_program && i < snek_image_program->size && !snek_abort; i += 2) {
+		snek_poly_t *data = snek_list_data(snek_image_program);
+		snek_poly_t name = data[i];
+		snek_poly_t value = data[i + 1];
+
+		if (snek_is_null(name)) {
+			snek_func_t *func = snek_poly_to_func(value);
+			SNEK_CODE_HOOK_START
+			snek_exec(snek_pool_addr(func->code));
+			SNEK_CODE_HOOK_STOP
+		} else {
+			snek_stack_push(value);
+			snek_poly_t *ref = snek_id_ref((snek_id_t) snek_poly_to_float(name), true);
+			value = snek_stack_pop();
+			if (ref)
+				*ref = value;
+		}
+	}
+	snek_image_program = NULL;
+	return !snek_abort;
+}
+
+#endif
@@ -37,8 +37,9 @@ snek_builtin_input(uint8_t nposition, uint8_t nnamed, snek_poly_t *args)
 		if (snek_is_null(s)) {
 			s = snek_string_make(c);
 		} else {
+			char *a = snek_poly_to_string(s);
 			in[0] = c;
-			s = snek_string_cat(snek_poly_to_string(s), in);
+			s = snek_string_to_poly(snek_string_catn(a, 0, snek_string_len(a), in, 0, 1));
 		}
 	}
 	snek_in_input = false;
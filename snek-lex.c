@@ -282,10 +282,11 @@ string(char q)
 	for (;;) {
 		c = lexchar();
 		if (c == q) {
-			char *ret = snek_alloc(snek_lex_len + 1);
+			snek_offset_t len = strlen(snek_lex_text);
+			char *ret = snek_string_alloc(len);
 			if (!ret)
 				RETURN(TOKEN_INVALID);
-			strcpy(ret, snek_lex_text);
+			memcpy(ret, snek_lex_text, len);
 			snek_token_val.string = ret;
 			RETURN(STRING);
 		}
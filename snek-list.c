@@ -26,10 +26,196 @@ snek_list_data(snek_list_t *list)
 	return snek_pool_addr(list->data);
 }
 
+#ifdef SNEK_DICT_HASH
+
+/*
+ * Dicts keep their key/value pairs in the order they were added, so
+ * adding a key doesn't move any others. Dicts with room for at least
+ * SNEK_DICT_INDEX / 2 pairs follow the pairs in the same block with
+ * an open-addressed index holding the offset of each key plus one,
+ * which finds keys without comparing along a search path; smaller
+ * dicts just search the pairs. Wherever the order is visible, the
+ * pairs are first sorted by key, so dicts print, iterate and compare
+ * the same as without the index. The index holds offsets rather than
+ * addresses, so moving the block during compaction leaves it valid.
+ * Functions move too, so they all hash alike.
+ */
+
+#define SNEK_DICT_INDEX	32
+
+/* Entries in the index for 'alloc' values, keeping it under 2/3 full */
+static snek_offset_t
+snek_dict_index_size(snek_offset_t alloc)
+{
+	snek_offset_t size;
+
+	if (alloc < SNEK_DICT_INDEX)
+		return 0;
+	for (size = SNEK_DICT_INDEX; size < (alloc >> 1) + (alloc >> 2); size <<= 1)
+		;
+	return size;
+}
+
+static snek_offset_t *
+snek_dict_index(snek_list_t *list)
+{
+	return (snek_offset_t *) (snek_list_data(list) + list->alloc);
+}
+
+static snek_offset_t
+snek_poly_hash(snek_poly_t p)
+{
+	snek_offset_t h;
+	const char *s;
+
+	switch (snek_poly_type(p)) {
+	case snek_float:
+		if (p.f == 0.0f)
+			return 0;
+		return (snek_offset_t) (p.u ^ (p.u >> 16));
+	case snek_string:
+		h = 0;
+		for (s = snek_poly_to_string(p); *s; s++)
+			h = h * 31 + (uint8_t) *s;
+		return h;
+	case snek_list:
+		h = 1;
+		snek_list_t *list = snek_poly_to_list(p);
+		if (snek_list_readonly(list)) {
+			snek_poly_t *data = snek_list_data(list);
+			for (snek_offset_t o = 0; o < list->size; o++)
+				h = h * 31 + snek_poly_hash(data[o]);
+		}
+		return h;
+	case snek_func:
+		return snek_func;
+	default:
+		return (snek_offset_t) p.u;
+	}
+}
+
+static snek_offset_t *
+snek_dict_slot(snek_list_t *list, snek_poly_t key)
+{
+	snek_poly_t	*data = snek_list_data(list);
+	snek_offset_t	*index = snek_dict_index(list);
+	snek_offset_t	mask = snek_dict_index_size(list->alloc) - 1;
+	snek_offset_t	h;
+	snek_offset_t	o;
+
+	for (h = snek_poly_hash(key) & mask; (o = index[h]); h = (h + 1) & mask)
+		if (snek_poly_cmp(key, data[o-1], false) == 0)
+			break;
+	return &index[h];
+}
+
+static void
+snek_dict_rehash(snek_list_t *list, snek_offset_t size)
+{
+	snek_poly_t	*data = snek_list_data(list);
+	snek_offset_t	o;
+
+	memset(snek_dict_index(list), '\0', snek_dict_index_size(list->alloc) * sizeof (snek_offset_t));
+	for (o = 0; o < size; o += 2)
+		*snek_dict_slot(list, data[o]) = o + 1;
+}
+
+/* Return the offset of 'key' within the dict, or list->size if missing */
+static snek_offset_t
+snek_dict_find(snek_list_t *list, snek_poly_t key)
+{
+	snek_poly_t	*data = snek_list_data(list);
+	snek_offset_t	o;
+
+	if (snek_dict_index_size(list->alloc)) {
+		o = *snek_dict_slot(list, key);
+		return o ? o - 1 : list->size;
+	}
+	for (o = 0; o < list->size; o += 2)
+		if (snek_poly_cmp(key, data[o], false) == 0)
+			break;
+	return o;
+}
+
+bool
+snek_dict_has(snek_list_t *list, snek_poly_t key)
+{
+	return snek_dict_find(list, key) < list->size;
+}
+
+static void
+snek_dict_swap(snek_poly_t *data, snek_offset_t a, snek_offset_t b)
+{
+	snek_poly_t	t;
+	uint8_t		i;
+
+	for (i = 0; i < 2; i++) {
+		t = data[a + i];
+		data[a + i] = data[b + i];
+		data[b + i] = t;
+	}
+}
+
+/* Move pair 'p' down the heap of 'n' pairs to where it belongs */
+static void
+snek_dict_sift(snek_poly_t *data, snek_offset_t p, snek_offset_t n)
+{
+	snek_offset_t	c;
+
+	while ((c = p * 2 + 1) < n) {
+		if (c + 1 < n && snek_poly_cmp(data[c * 2], data[c * 2 + 2], false) < 0)
+			c++;
+		if (snek_poly_cmp(data[p * 2], data[c * 2], false) >= 0)
+			break;
+		snek_dict_swap(data, p * 2, c * 2);
+		p = c;
+	}
+}
+
+/*
+ * Sort the pairs by key before their order is seen. This heap sorts
+ * in place, as there may not be memory for anything else
+ */
+void
+snek_dict_sort(snek_list_t *list)
+{
+	snek_poly_t	*data = snek_list_data(list);
+	snek_offset_t	n = list->size >> 1;
+	snek_offset_t	p;
+
+	for (p = 1; p < n; p++)
+		if (snek_poly_cmp(data[p * 2 - 2], data[p * 2], false) > 0)
+			break;
+	if (p >= n)
+		return;
+	for (p = n >> 1; p--;)
+		snek_dict_sift(data, p, n);
+	while (--n) {
+		snek_dict_swap(data, 0, n * 2);
+		snek_dict_sift(data, 0, n);
+	}
+	if (snek_dict_index_size(list->alloc))
+		snek_dict_rehash(list, list->size);
+}
+
+static snek_offset_t
+snek_list_bytes(snek_list_t *list, snek_offset_t alloc)
+{
+	snek_offset_t bytes = alloc * sizeof (snek_poly_t);
+
+	if (snek_list_type(list) == snek_list_dict)
+		bytes += snek_dict_index_size(alloc) * sizeof (snek_offset_t);
+	return bytes;
+}
+#else
+#define snek_list_bytes(list, alloc)	((alloc) * sizeof (snek_poly_t))
+#endif
+
 snek_list_t *
 snek_list_resize(snek_list_t *list, snek_offset_t size)
 {
 	if (list->alloc >= size) {
+		snek_remember(list);
 		list->size = size;
 		return list;
 	}
@@ -37,18 +223,25 @@ snek_list_resize(snek_list_t *list, snek_offset_t size)
 	snek_offset_t alloc = snek_list_readonly(list) ? size : snek_list_alloc(size);
 
 	snek_stack_push_list(list);
-	snek_poly_t *data = snek_alloc(alloc * sizeof (snek_poly_t));
+	snek_poly_t *data = snek_alloc(snek_list_bytes(list, alloc));
 	list = snek_stack_pop_list();
 
 	if (!data)
 		return false;
+	snek_remember(list);
 	snek_offset_t to_copy = size;
 	if (to_copy > list->size)
 		to_copy = list->size;
 	memcpy(data, snek_list_data(list), to_copy * sizeof (snek_poly_t));
+	if (list->alloc)
+		snek_free(snek_list_data(list), snek_list_bytes(list, list->alloc));
 	list->data = snek_pool_offset(data);
 	list->size = size;
 	list->alloc = alloc;
+#ifdef SNEK_DICT_HASH
+	if (snek_list_type(list) == snek_list_dict && snek_dict_index_size(alloc))
+		snek_dict_rehash(list, to_copy);
+#endif
 	return list;
 }
 
@@ -163,9 +356,12 @@ _snek_list_ref(snek_list_t *list, snek_poly_t p, bool report_error, bool add)
 	snek_offset_t o;
 	snek_poly_t *data = snek_list_data(list);
 
-	(void) add;
 #ifndef SNEK_NO_DICT
 	if (snek_list_type(list) == snek_list_dict) {
+#ifdef SNEK_DICT_HASH
+		o = snek_dict_find(list, p);
+		if (o == list->size) {
+#else
 		snek_offset_t l = 0, r = list->size;
 		while (l < r) {
 			o = ((l + r) >> 1) & ~1;
@@ -177,6 +373,7 @@ _snek_list_ref(snek_list_t *list, snek_poly_t p, bool report_error, bool add)
 		}
 		o = l;
 		if (o >= list->size || snek_poly_cmp(p, data[o], false) != 0) {
+#endif
 			if (!add)
 				goto fail;
 			if (snek_mutable(p))
@@ -187,8 +384,15 @@ _snek_list_ref(snek_list_t *list, snek_poly_t p, bool report_error, bool add)
 			if (!list)
 				return NULL;
 			data = snek_list_data(list);
+#ifdef SNEK_DICT_HASH
+			/* New keys go on the end */
+			data[o] = p;
+			if (snek_dict_index_size(list->alloc))
+				*snek_dict_slot(list, p) = o + 1;
+#else
 			memmove(data + o + 2, data + o, (list->size - o - 2) * sizeof (snek_poly_t));
 			data[o] = p;
+#endif
 		}
 		o++;
 	} else
@@ -201,6 +405,8 @@ _snek_list_ref(snek_list_t *list, snek_poly_t p, bool report_error, bool add)
 		if (list->size <= o)
 			goto fail;
 	}
+	if (add)
+		snek_remember(list);
 	return &data[o];
 fail:
 	if (report_error)
@@ -247,6 +453,10 @@ snek_list_del(snek_poly_t lp, snek_poly_t p)
 	snek_offset_t remain = snek_list_data(list) + list->size - r;
 	memmove(r, r + num, (remain - num) * sizeof (snek_poly_t));
 	list->size -= num;
+#ifdef SNEK_DICT_HASH
+	if (num == 2 && snek_dict_index_size(list->alloc))
+		snek_dict_rehash(list, list->size);
+#endif
 }
 
 int8_t
@@ -255,6 +465,12 @@ snek_list_cmp(snek_list_t *a, snek_list_t *b)
 	int8_t diff = snek_list_type(a) - snek_list_type(b);
 	if (diff)
 		return diff;
+#ifdef SNEK_DICT_HASH
+	if (snek_list_type(a) == snek_list_dict) {
+		snek_dict_sort(a);
+		snek_dict_sort(b);
+	}
+#endif
 	snek_poly_t *adata = snek_list_data(a);
 	snek_poly_t *bdata = snek_list_data(b);
 
@@ -323,6 +539,10 @@ snek_list_slice(snek_list_t *list, snek_slice_t *slice)
 	bool readonly = snek_list_readonly(list);
 	if (readonly && slice->identity)
 	    return list;
+#ifdef SNEK_DICT_HASH
+	if (snek_list_type(list) == snek_list_dict)
+		snek_dict_sort(list);
+#endif
 
 	snek_stack_push_list(list);
 	snek_list_t *n = snek_list_make(slice->count, readonly);
@@ -332,8 +552,11 @@ snek_list_slice(snek_list_t *list, snek_slice_t *slice)
 	snek_offset_t i = 0;
 	snek_poly_t *data = snek_list_data(list);
 	snek_poly_t *ndata = snek_list_data(n);
-	for (; snek_slice_test(slice); snek_slice_step(slice))
-		ndata[i++] = data[slice->pos];
+	if (slice->stride == 1)
+		memcpy(ndata, data + slice->pos, slice->count * sizeof (snek_poly_t));
+	else
+		for (; snek_slice_test(slice); snek_slice_step(slice))
+			ndata[i++] = data[slice->pos];
 	return n;
 }
 #endif
@@ -364,7 +587,7 @@ snek_list_mark(void *addr)
 	debug_memory("\t\tmark list size %d alloc %d data %d\n", list->size, list->alloc, list->data);
 	if (list->alloc) {
 		snek_poly_t *data = snek_list_data(list);
-		snek_mark_blob(data, list->alloc * sizeof (snek_poly_t));
+		snek_mark_blob(data, snek_list_bytes(list, list->alloc));
 		for (snek_offset_t i = 0; i < list->size; i++)
 			snek_poly_mark_ref(&data[i]);
 	}
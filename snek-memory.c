@@ -18,10 +18,18 @@
 #ifdef SNEK_DYNAMIC
 uint8_t 	*snek_pool  __attribute__((aligned(SNEK_ALLOC_ROUND)));
 uint32_t	snek_pool_size;
+uint32_t	snek_pool_max = SNEK_POOL_MAX;
 #else
 uint8_t	snek_pool[SNEK_POOL] __attribute__((aligned(SNEK_ALLOC_ROUND)));
 #endif
 
+#ifdef SNEK_ROM
+const uint8_t	*snek_rom;
+snek_offset_t	snek_rom_size;
+#endif
+
+static snek_offset_t	snek_top;
+
 struct snek_root {
 	const snek_mem_t	*type;
 	void			**addr;
@@ -34,10 +42,17 @@ struct snek_root {
 #endif
 
 static const struct snek_root	SNEK_ROOT_DECLARE(snek_root)[] = {
+#ifdef SNEK_NAME_HASH
+	{
+		.type = &snek_name_table_mem,
+		.addr = (void **) (void *) &snek_name_table,
+	},
+#else
 	{
 		.type = &snek_name_mem,
 		.addr = (void **) (void *) &snek_names,
 	},
+#endif
 	{
 		.type = &snek_frame_mem,
 		.addr = (void **) (void *) &snek_globals,
@@ -58,6 +73,18 @@ static const struct snek_root	SNEK_ROOT_DECLARE(snek_root)[] = {
 		.type = &_snek_mems[snek_list - 1],
 		.addr = (void **) (void *) &snek_empty_tuple,
 	},
+#ifdef SNEK_STRING_CHARS
+	{
+		.type = &_snek_mems[snek_list - 1],
+		.addr = (void **) (void *) &snek_string_chars,
+	},
+#endif
+#ifdef SNEK_STRING_BUILDER
+	{
+		.type = &snek_builder_mem,
+		.addr = (void **) (void *) &snek_builder,
+	},
+#endif
 	{
 		.type = NULL,
 		.addr = (void **) (void *) &snek_a,
@@ -66,6 +93,12 @@ static const struct snek_root	SNEK_ROOT_DECLARE(snek_root)[] = {
 		.type = &snek_compile_mem,
 		.addr = (void **) (void *) &snek_compile,
 	},
+#ifdef SNEK_IMAGE
+	{
+		.type = &_snek_mems[snek_list - 1],
+		.addr = (void **) (void *) &snek_image_program,
+	},
+#endif
 };
 
 #ifdef SNEK_MEM_CACHE_NUM
@@ -79,9 +112,17 @@ static const void ** const snek_mem_cache[] = {
 
 #define SNEK_ROOT	(sizeof (snek_root) / sizeof (snek_root[0]))
 
-#define SNEK_BUSY_SIZE		((SNEK_POOL + 31) / 32)
+#define SNEK_BUSY_SIZE		((SNEK_POOL_SIZE + 31) / 32)
 #define SNEK_NCHUNK_EST(pool)	((pool) / 64)
 
+/*
+ * Both incremental marking and borrowed chunk tables use a map of
+ * the allocation units covered by live objects
+ */
+#if defined(SNEK_INCREMENTAL_MARK) || defined(SNEK_CHUNK_BORROW)
+#define SNEK_EXTENT
+#endif
+
 struct snek_chunk {
 	snek_offset_t		old_offset;
 	union {
@@ -92,35 +133,134 @@ struct snek_chunk {
 
 #ifdef SNEK_DYNAMIC
 static uint8_t	*snek_busy;
+#ifdef SNEK_EXTENT
+static uint8_t	*snek_extent;
+#endif
 static struct snek_chunk *snek_chunk;
 static snek_offset_t	SNEK_NCHUNK;
+#ifdef SNEK_CHUNK_BORROW
+static struct snek_chunk *snek_chunk_fixed;
+static snek_offset_t	SNEK_NCHUNK_FIXED;
+#endif
 
 typedef snek_offset_t snek_chunk_t;
 
-bool
-snek_mem_alloc(snek_poly_t pool_size)
-{
-	snek_poly_t	busy_size = (pool_size + 31) / 32;
+#ifdef SNEK_INCREMENTAL_MARK
+static void
+snek_gray_realloc(uint8_t *pool, uint32_t pool_size);
+#endif
 
-	snek_pool = malloc(pool_size +
-				busy_size +
-				busy_size +
-				busy_size +
-				SNEK_NCHUNK_EST(pool_size) * sizeof (struct snek_chunk));
-	if (!snek_pool)
+/*
+ * Move the heap and its collector tables to a block sized for
+ * pool_size bytes. Offsets stay the same, so only the root pointers
+ * need adjusting; everything else refers to the heap by offset.
+ */
+static bool
+snek_mem_realloc(uint32_t pool_size)
+{
+	uint32_t	busy_size = (pool_size + 31) / 32;
+	uint8_t		*old_pool = snek_pool;
+	uint32_t	old_busy_size = SNEK_BUSY_SIZE;
+	uint8_t		*pool;
+	snek_offset_t	i;
+
+	pool = malloc(pool_size +
+		      busy_size +
+		      busy_size +
+		      busy_size +
+		      SNEK_NCHUNK_EST(pool_size) * sizeof (struct snek_chunk));
+	if (!pool)
 		return false;
+	SNEK_COLLECT_HOOK_START;
+	debug_memory("Pool %d -> %d\n", snek_pool_size, pool_size);
+	memset(pool + pool_size, '\0', 2 * busy_size);
+	if (old_pool) {
+		memcpy(pool, old_pool, snek_top);
+#ifdef SNEK_INCREMENTAL_MARK
+		snek_gray_realloc(pool, pool_size);
+#endif
+		memcpy(pool + pool_size, snek_busy, old_busy_size);
+#ifdef SNEK_EXTENT
+		memcpy(pool + pool_size + busy_size, snek_extent, old_busy_size);
+#endif
+		for (i = 0; i < (snek_offset_t) SNEK_ROOT; i++) {
+			if (SNEK_ROOT_TYPE(&snek_root[i])) {
+				void **a = SNEK_ROOT_ADDR(&snek_root[i]);
+				if (a && *a && !snek_is_rom_addr(*a))
+					*a = pool + ((uint8_t *) *a - old_pool);
+			}
+		}
+		free(old_pool);
+	}
+	snek_pool = pool;
 	snek_busy = snek_pool + pool_size;
+#ifdef SNEK_EXTENT
+	snek_extent = snek_busy + busy_size;
+	snek_chunk = (struct snek_chunk *) (((uintptr_t)(snek_extent + busy_size) + 7) & ~7);
+#else
 	snek_chunk = (struct snek_chunk *) (((uintptr_t)(snek_busy + busy_size) + 7) & ~7);
+#endif
 	snek_pool_size = pool_size;
 	SNEK_NCHUNK = SNEK_NCHUNK_EST(pool_size);
+#ifdef SNEK_CHUNK_BORROW
+	snek_chunk_fixed = snek_chunk;
+	SNEK_NCHUNK_FIXED = SNEK_NCHUNK;
+#endif
+	SNEK_COLLECT_HOOK_STOP;
 	return true;
 }
 
+bool
+snek_mem_alloc(uint32_t pool_size)
+{
+	if (snek_pool_max > SNEK_POOL_MAX)
+		snek_pool_max = SNEK_POOL_MAX;
+	if (pool_size > snek_pool_max)
+		pool_size = snek_pool_max;
+	return snek_mem_realloc(pool_size & ~(SNEK_ALLOC_ROUND - 1));
+}
+
+/*
+ * Called when even a full collection leaves too little space
+ * for an allocation of 'size' bytes. The pool doubles until the
+ * request fits, up to snek_pool_max.
+ */
+static bool
+snek_mem_grow(snek_offset_t size)
+{
+	uint32_t	need = (uint32_t) snek_top + size;
+	uint32_t	pool_size = snek_pool_size;
+
+	if (need > snek_pool_max)
+		return false;
+	while (pool_size < need)
+		pool_size *= 2;
+	if (pool_size > snek_pool_max)
+		pool_size = snek_pool_max & ~(SNEK_ALLOC_ROUND - 1);
+	return snek_mem_realloc(pool_size);
+}
+
+#else
+
+static uint8_t			snek_busy[SNEK_BUSY_SIZE];
+#ifdef SNEK_EXTENT
+static uint8_t			snek_extent[SNEK_BUSY_SIZE];
+#endif
+
+#ifdef SNEK_CHUNK_BORROW
+
+#define SNEK_NCHUNK_FIXED SNEK_NCHUNK_EST(SNEK_POOL)
+
+static struct snek_chunk	snek_chunk_fixed[SNEK_NCHUNK_FIXED];
+static struct snek_chunk	*snek_chunk = snek_chunk_fixed;
+static snek_offset_t		SNEK_NCHUNK = SNEK_NCHUNK_FIXED;
+
+typedef snek_offset_t snek_chunk_t;
+
 #else
 
 #define SNEK_NCHUNK SNEK_NCHUNK_EST(SNEK_POOL)
 
-static uint8_t			snek_busy[SNEK_BUSY_SIZE];
 static struct snek_chunk	snek_chunk[SNEK_NCHUNK];
 
 #if SNEK_NCHUNK < 255
@@ -131,16 +271,103 @@ typedef snek_offset_t snek_chunk_t;
 
 #endif
 
+#endif
+
 static snek_offset_t	snek_note_list = SNEK_OFFSET_NONE;
 
-static snek_offset_t	snek_top;
+snek_offset_t snek_last_top;
+uint8_t snek_collect_counts;
+
+#ifdef SNEK_GC_STATS
+/*
+ * Counters reported by gc.stats(). Pause times are measured with
+ * SNEK_GC_TIME, which returns microseconds.
+ */
+#ifndef SNEK_GC_TIME
+#define SNEK_GC_TIME()	0
+#endif
+
+static struct snek_gc_stats {
+	uint64_t	allocated;	/* bytes handed out by snek_alloc */
+	uint32_t	full;		/* full collections */
+	uint32_t	incremental;	/* incremental collections */
+	uint64_t	pause;		/* total time spent collecting */
+	uint32_t	pause_max;	/* longest single collection */
+	uint32_t	overflow;	/* extra passes when the chunk table filled */
+} snek_gc_stats;
+
+#define SNEK_CENSUS_TYPES	6
+
+static const char * const snek_census_name[SNEK_CENSUS_TYPES] = {
+	"name", "frame", "code", "list", "string", "func"
+};
+
+/* List storage is the only object marked without a type */
+#define SNEK_CENSUS_LIST	3
+
+static bool	snek_census;
+static uint8_t	snek_census_type = SNEK_CENSUS_LIST;
+static uint32_t	snek_census_live[SNEK_CENSUS_TYPES];
+
+#define snek_gc_count(field)	(snek_gc_stats.field++)
+#else
+#define snek_gc_count(field)
+#endif
+
+#ifdef SNEK_FREE_LIST
+/*
+ * Blocks known to be dead, like popped frames and outgrown list
+ * storage, are kept on lists by size so that snek_alloc can hand
+ * them out again without compacting the heap. Each block holds the
+ * offset of the next one in its first word. Collection reclaims the
+ * space anyway, so the lists are simply discarded then.
+ */
+#define SNEK_FREE_CLASSES	(SNEK_FREE_LIST >> SNEK_ALLOC_SHIFT)
+
+static snek_offset_t	snek_free_list[SNEK_FREE_CLASSES] = {
+	[0 ... SNEK_FREE_CLASSES - 1] = SNEK_OFFSET_NONE
+};
+
+#define snek_free_class(size)	(&snek_free_list[((size) >> SNEK_ALLOC_SHIFT) - 1])
+#endif
+
+#ifdef SNEK_GENERATIONAL
+/*
+ * Objects below snek_last_top have survived a collection. Minor
+ * collections leave them in place and only mark and compact the
+ * nursery above, so any reference from an old object into the
+ * nursery must be found without walking the old objects. Old lists
+ * which have been stored into are recorded in the remembered set;
+ * frames and the root objects are always scanned, just like the
+ * stack.
+ */
+static snek_offset_t	snek_remember_set[SNEK_GENERATIONAL];
+static snek_offset_t	snek_remember_num;
+static bool		snek_collect_minor;
+
+void
+snek_remember_offset(snek_offset_t offset)
+{
+	snek_offset_t i;
+
+	if (snek_remember_num >= SNEK_GENERATIONAL) {
+		/* Overflow, the next collection will be a full one */
+		snek_remember_num = SNEK_GENERATIONAL + 1;
+		return;
+	}
+	for (i = snek_remember_num; i;)
+		if (snek_remember_set[--i] == offset)
+			return;
+	snek_remember_set[snek_remember_num++] = offset;
+}
+#endif
 
 /* Offset of an address within the pool. */
 static snek_offset_t pool_offset(const void *addr) {
 #if SNEK_DEBUG
 	if (addr == NULL)
 		snek_panic("null in pool_offset");
-	if ((uint8_t *) addr < snek_pool || &snek_pool[SNEK_POOL] <= (uint8_t *) addr)
+	if ((uint8_t *) addr < snek_pool || &snek_pool[SNEK_POOL_SIZE] <= (uint8_t *) addr)
 		snek_panic("out of bounds in pool_offset");
 	if (((uintptr_t) addr & (SNEK_ALLOC_ROUND-1)) != 0)
 		snek_panic("unaligned addr in pool_offset");
@@ -153,7 +380,7 @@ static void *pool_addr(snek_offset_t offset) {
 #if SNEK_DEBUG
 	if (snek_offset_is_none(offset))
 		snek_panic("none in pool_addr");
-	if (offset >= SNEK_POOL)
+	if (offset >= SNEK_POOL_SIZE)
 		snek_panic("out of bounds in pool_addr");
 	if ((offset & (SNEK_ALLOC_ROUND-1)) != 0)
 		snek_panic("unaligned offset in pool_addr");
@@ -180,11 +407,44 @@ static bool busy(snek_offset_t offset) {
 	return (snek_busy[tag_byte(offset)] >> tag_bit(offset)) & 1;
 }
 
+#ifdef SNEK_EXTENT
+/*
+ * The extent map records every allocation unit covered by a marked
+ * object, so that the compactor can find the live objects without
+ * walking the heap again
+ */
+static bool extent(snek_offset_t offset) {
+	return (snek_extent[tag_byte(offset)] >> tag_bit(offset)) & 1;
+}
+
+static void set_extent_bit(snek_offset_t offset, bool set) {
+	if (set)
+		snek_extent[tag_byte(offset)] |= (1 << tag_bit(offset));
+	else
+		snek_extent[tag_byte(offset)] &= ~(1 << tag_bit(offset));
+}
+
+static void set_extent(snek_offset_t offset, snek_offset_t size, bool set) {
+	snek_offset_t end = offset + size;
+	snek_offset_t bytes;
+
+	for (; offset < end && tag_bit(offset); offset += SNEK_ALLOC_ROUND)
+		set_extent_bit(offset, set);
+	bytes = (end - offset) >> (SNEK_ALLOC_SHIFT + 3);
+	if (bytes) {
+		memset(&snek_extent[tag_byte(offset)], set ? 0xff : 0x00, bytes);
+		offset += bytes << (SNEK_ALLOC_SHIFT + 3);
+	}
+	for (; offset < end; offset += SNEK_ALLOC_ROUND)
+		set_extent_bit(offset, set);
+}
+#endif
+
 bool
 snek_is_pool_addr(const void *addr)
 {
 	const uint8_t *a = addr;
-	return (snek_pool <= a) && (a < snek_pool + SNEK_POOL);
+	return (snek_pool <= a) && (a < snek_pool + SNEK_POOL_SIZE);
 }
 
 static snek_offset_t
@@ -288,6 +548,38 @@ reset_chunks(void)
  * Walk all referenced objects calling functions on each one
  */
 
+#ifdef SNEK_GENERATIONAL
+
+/*
+ * During a minor collection, old objects are skipped unless they
+ * may hold references into the nursery
+ */
+static bool
+snek_collect_skip(const struct snek_mem *type, void *addr)
+{
+	return snek_collect_minor && type != &snek_frame_mem && pool_offset(addr) < snek_last_top;
+}
+
+/*
+ * Visit the contents of an old object which may refer to the
+ * nursery. The object itself never moves during a minor collection
+ */
+static void
+visit_old(const struct snek_mem *type, void *addr,
+	  bool (*visit_addr)(const struct snek_mem *type, void **addr))
+{
+	snek_offset_t offset = pool_offset(addr);
+
+	if (busy(offset))
+		return;
+	mark(offset);
+	if (visit_addr == snek_move_addr)
+		SNEK_MEM_MOVE(type)(addr);
+	else
+		SNEK_MEM_MARK(type)(addr);
+}
+#endif
+
 static void
 walk(bool (*visit_addr)(const struct snek_mem *type, void **addr),
      bool (*visit_poly)(snek_poly_t *p))
@@ -301,7 +593,12 @@ walk(bool (*visit_addr)(const struct snek_mem *type, void **addr),
 		const snek_mem_t *mem = SNEK_ROOT_TYPE(&snek_root[i]);
 		if (mem) {
 			void **a = SNEK_ROOT_ADDR(&snek_root[i]), *v;
-			if (a == NULL || (v = *a) != NULL) {
+			if (a == NULL || ((v = *a) != NULL && !snek_is_rom_addr(v))) {
+#ifdef SNEK_GENERATIONAL
+				if (snek_collect_minor && a && pool_offset(*a) < snek_last_top)
+					visit_old(mem, *a, visit_addr);
+				else
+#endif
 				visit_addr(mem, a);
 			}
 		} else {
@@ -311,6 +608,12 @@ walk(bool (*visit_addr)(const struct snek_mem *type, void **addr),
 			}
 		}
 	}
+#ifdef SNEK_GENERATIONAL
+	if (snek_collect_minor) {
+		for (i = 0; i < snek_remember_num; i++)
+			visit_old(snek_mems(snek_list), pool_addr(snek_remember_set[i]), visit_addr);
+	}
+#endif
 	while (!snek_offset_is_none(snek_note_list)) {
 		snek_offset_t note = snek_note_list;
 		snek_note_list = SNEK_OFFSET_NONE;
@@ -340,8 +643,277 @@ snek_poly_mark_ref(snek_poly_t *p)
 	return snek_poly_mark(*p);
 }
 
-snek_offset_t snek_last_top;
-uint8_t snek_collect_counts;
+#ifdef SNEK_EXTENT
+
+/*
+ * Find the next run of marked units at or above *offset
+ */
+static bool
+extent_run(snek_offset_t *offset, snek_offset_t *start)
+{
+	snek_offset_t	o = *offset;
+
+	while (o < snek_top) {
+		if (tag_bit(o) == 0 && snek_extent[tag_byte(o)] == 0x00) {
+			o += SNEK_ALLOC_ROUND << 3;
+			continue;
+		}
+		if (!extent(o)) {
+			o += SNEK_ALLOC_ROUND;
+			continue;
+		}
+		*start = o;
+		while (o < snek_top) {
+			if (tag_bit(o) == 0 && snek_extent[tag_byte(o)] == 0xff)
+				o += SNEK_ALLOC_ROUND << 3;
+			else if (extent(o))
+				o += SNEK_ALLOC_ROUND;
+			else
+				break;
+		}
+		if (o > snek_top)
+			o = snek_top;
+		*offset = o;
+		return true;
+	}
+	return false;
+}
+
+/*
+ * Fill the chunk array from runs in the extent map
+ */
+static void
+extent_chunks(void)
+{
+	snek_offset_t	offset = chunk_low, start;
+
+	while (extent_run(&offset, &start)) {
+		debug_memory("add extent chunk %d offset %d size %d\n", chunk_last, start, offset - start);
+		snek_chunk[chunk_last].old_offset = start;
+		snek_chunk[chunk_last].size = offset - start;
+		if (++chunk_last == SNEK_NCHUNK) {
+			chunk_high = offset;
+			break;
+		}
+	}
+}
+#endif
+
+#ifdef SNEK_CHUNK_BORROW
+
+static bool	snek_collect_extent;
+
+/*
+ * Mark the heap into the extent map and then place a chunk table
+ * with room for every run in the free space above snek_top, so
+ * that a single move pass relocates everything. When there isn't
+ * enough free space, use the fixed table and compact in several
+ * passes without marking again.
+ */
+static void
+extent_mark(bool marked)
+{
+	snek_offset_t	offset = chunk_low, start;
+	snek_offset_t	nrun = 0;
+
+	if (!marked) {
+		memset(&snek_extent[tag_byte(chunk_low)], '\0', SNEK_BUSY_SIZE - tag_byte(chunk_low));
+		snek_collect_extent = true;
+		walk(snek_mark_ref, snek_poly_mark_ref);
+		snek_collect_extent = false;
+	}
+	while (extent_run(&offset, &start))
+		nrun++;
+
+	/* Leave one spare entry so the table never fills */
+	if ((snek_offset_t) (nrun + 1) <= (SNEK_POOL_SIZE - snek_top) / sizeof (struct snek_chunk)) {
+		snek_chunk = (struct snek_chunk *) (void *) &snek_pool[snek_top];
+		SNEK_NCHUNK = nrun + 1;
+	} else {
+		snek_chunk = snek_chunk_fixed;
+		SNEK_NCHUNK = SNEK_NCHUNK_FIXED;
+	}
+	debug_memory("%d runs, chunk table %d\n", nrun, SNEK_NCHUNK);
+}
+#endif
+
+#ifdef SNEK_INCREMENTAL_MARK
+
+/*
+ * Tri-color marking spread across allocations. Marked objects have
+ * their extent recorded; gray objects are also on the mark stack
+ * waiting for their contents to be scanned. Each snek_alloc call
+ * scans up to SNEK_INCREMENTAL_MARK gray objects. Stores into
+ * black lists push them back on the mark stack, while frames and
+ * the root objects are scanned again when marking finishes. Once
+ * the mark stack empties, the collection which was due anyway is
+ * run using the extent map instead of walking the heap again; that
+ * is normally a minor one, compacting only objects allocated since
+ * the last collection.
+ *
+ * Gray objects which don't fit on the mark stack spill down from
+ * the end of the heap, and snek_alloc stays below them. Only when
+ * that free space runs out too is the marking given up, leaving the
+ * collection which must then happen to mark the heap itself.
+ */
+
+#ifndef SNEK_MARK_STACK
+#define SNEK_MARK_STACK	128
+#endif
+
+bool snek_marking;
+
+static struct snek_gray {
+	const struct snek_mem	*type;
+	snek_offset_t		offset;
+} snek_gray[SNEK_MARK_STACK];
+
+static snek_offset_t	snek_ngray;
+static bool		snek_gray_overflow;
+static snek_offset_t	snek_mark_trigger;
+
+/* Where spilled gray object 'i' lives in the heap ending at 'end' */
+static struct snek_gray *
+snek_gray_spilled(uint8_t *end, snek_offset_t i)
+{
+	uintptr_t e = (uintptr_t) end & ~(uintptr_t) (sizeof (void *) - 1);
+
+	return (struct snek_gray *) e - 1 - (i - SNEK_MARK_STACK);
+}
+
+static struct snek_gray *
+snek_gray_entry(snek_offset_t i)
+{
+	if (i < SNEK_MARK_STACK)
+		return &snek_gray[i];
+	return snek_gray_spilled(snek_pool + SNEK_POOL_SIZE, i);
+}
+
+/* Bytes at the end of the heap holding spilled gray objects */
+static snek_offset_t
+snek_gray_spill(void)
+{
+	if (snek_ngray <= SNEK_MARK_STACK)
+		return 0;
+	return (snek_offset_t) (snek_pool + SNEK_POOL_SIZE - (uint8_t *) snek_gray_entry(snek_ngray - 1));
+}
+
+#ifdef SNEK_DYNAMIC
+/* Carry spilled gray objects along to the end of a new heap */
+static void
+snek_gray_realloc(uint8_t *pool, uint32_t pool_size)
+{
+	if (snek_ngray > SNEK_MARK_STACK)
+		memcpy(snek_gray_spilled(pool + pool_size, snek_ngray - 1),
+		       snek_gray_entry(snek_ngray - 1),
+		       (snek_ngray - SNEK_MARK_STACK) * sizeof (struct snek_gray));
+}
+#endif
+
+static void
+snek_gray_push(const struct snek_mem *type, void *addr)
+{
+	struct snek_gray *gray = snek_gray_entry(snek_ngray);
+
+	if (snek_ngray >= SNEK_MARK_STACK && (uint8_t *) gray < snek_pool + snek_top) {
+		snek_gray_overflow = true;
+		return;
+	}
+	gray->type = type;
+	gray->offset = pool_offset(addr);
+	snek_ngray++;
+}
+
+static void
+snek_gray_scan(void)
+{
+	struct snek_gray *gray = snek_gray_entry(--snek_ngray);
+	const struct snek_mem *type = gray->type;
+	snek_offset_t offset = gray->offset;
+	void *addr = pool_addr(offset);
+
+	/* A replaced compile buffer can't be scanned as its size is global */
+	if (type == &snek_compile_mem && addr != snek_compile)
+		return;
+	set_extent(offset, snek_size(type, addr), true);
+	SNEK_MEM_MARK(type)(addr);
+}
+
+/*
+ * A black list is being modified; turn it gray again so that
+ * its new contents are scanned
+ */
+void
+snek_mark_barrier(snek_offset_t offset)
+{
+	if (extent(offset)) {
+		void *addr = pool_addr(offset);
+		set_extent(offset, snek_size(snek_mems(snek_list), addr), false);
+		snek_gray_push(snek_mems(snek_list), addr);
+	}
+}
+
+static void
+snek_mark_start(void)
+{
+	debug_memory("mark start\n");
+	memset(snek_extent, '\0', SNEK_BUSY_SIZE);
+	snek_ngray = 0;
+	snek_gray_overflow = false;
+	snek_marking = true;
+	walk(snek_mark_ref, snek_poly_mark_ref);
+}
+
+static void
+snek_mark_whiten(const struct snek_mem *type, void *addr)
+{
+	set_extent(pool_offset(addr), snek_size(type, addr), false);
+}
+
+static bool
+snek_mark_finish(void)
+{
+	snek_offset_t i;
+
+	debug_memory("mark finish\n");
+	for (i = 0; i < (snek_offset_t) SNEK_ROOT; i++) {
+		const snek_mem_t *mem = SNEK_ROOT_TYPE(&snek_root[i]);
+		void **a = SNEK_ROOT_ADDR(&snek_root[i]);
+
+		if (mem && a && *a && !snek_is_rom_addr(*a)) {
+			if (mem == &snek_frame_mem) {
+				snek_frame_t *f;
+				for (f = *a; f; f = snek_pool_addr(f->prev))
+					snek_mark_whiten(mem, f);
+			} else {
+				snek_mark_whiten(mem, *a);
+			}
+		}
+	}
+	walk(snek_mark_ref, snek_poly_mark_ref);
+	while (snek_ngray && !snek_gray_overflow)
+		snek_gray_scan();
+	snek_marking = false;
+	snek_ngray = 0;
+	return !snek_gray_overflow;
+}
+
+static void
+snek_mark_step(void)
+{
+	snek_offset_t work = SNEK_INCREMENTAL_MARK;
+
+	while (snek_ngray && work-- && !snek_gray_overflow)
+		snek_gray_scan();
+
+	/* After an overflow, the heap is full and will be collected soon */
+	if (!snek_ngray && !snek_gray_overflow)
+		snek_collect(SNEK_COLLECT_INCREMENTAL);
+}
+
+#else
+#define snek_gray_spill()	0
+#endif
 
 #ifdef DEBUG_MEMORY
 static void dump_busy(void)
@@ -363,6 +935,18 @@ snek_collect(uint8_t style)
 	snek_offset_t	top;
 
 	debug_memory("Collect...\n");
+	SNEK_COLLECT_HOOK_START;
+#ifdef SNEK_GC_STATS
+	uint32_t start = SNEK_GC_TIME();
+#endif
+#ifdef SNEK_EXTENT
+	bool marked = false;
+#endif
+#ifdef SNEK_INCREMENTAL_MARK
+	/* Finish any marking cycle and use it for this collection */
+	if (snek_marking && snek_mark_finish())
+		marked = true;
+#endif
 	/* The first time through, we're doing a full collect */
 	if (snek_last_top == 0)
 		style = SNEK_COLLECT_FULL;
@@ -372,9 +956,36 @@ snek_collect(uint8_t style)
 	if (snek_collect_counts >= 128)
 		style = SNEK_COLLECT_FULL;
 
+#ifdef SNEK_GENERATIONAL
+	/* Too many old lists were modified to track them all */
+	if (snek_remember_num > SNEK_GENERATIONAL)
+		style = SNEK_COLLECT_FULL;
+	snek_collect_minor = style != SNEK_COLLECT_FULL;
+#ifdef SNEK_INCREMENTAL_MARK
+	/*
+	 * The minor collection visits every remembered list, but those
+	 * which marking found dead may refer to objects it didn't mark
+	 */
+	if (marked && snek_collect_minor) {
+		snek_offset_t r, n = 0;
+
+		for (r = 0; r < snek_remember_num; r++)
+			if (extent(snek_remember_set[r]))
+				snek_remember_set[n++] = snek_remember_set[r];
+		snek_remember_num = n;
+	}
+#endif
+#endif
+
 	if (style == SNEK_COLLECT_FULL)
 		snek_collect_counts = 0;
+	else
+		snek_collect_counts++;
 
+#ifdef SNEK_FREE_LIST
+	for (c = 0; c < SNEK_FREE_CLASSES; c++)
+		snek_free_list[c] = SNEK_OFFSET_NONE;
+#endif
 #if SNEK_MEM_CACHE_NUM
 	for (c = 0; c < SNEK_MEM_CACHE_NUM; c++)
 		*snek_mem_cache[c] = NULL;
@@ -384,10 +995,19 @@ snek_collect(uint8_t style)
 	} else {
 		chunk_low = top = snek_last_top;
 	}
+#ifdef SNEK_CHUNK_BORROW
+	extent_mark(marked);
+	marked = true;
+#endif
 	for (;;) {
 		/* Find the sizes of the first chunk of objects to move */
 		reset_chunks();
 		debug_memory("mark\n");
+#ifdef SNEK_EXTENT
+		if (marked)
+			extent_chunks();
+		else
+#endif
 		walk(snek_mark_ref, snek_poly_mark_ref);
 		dump_busy();
 		debug_memory("done\n");
@@ -412,6 +1032,7 @@ snek_collect(uint8_t style)
 		 */
 		if (c == SNEK_NCHUNK) {
 			chunk_low = chunk_high;
+			snek_gc_count(overflow);
 			continue;
 		}
 
@@ -453,15 +1074,113 @@ snek_collect(uint8_t style)
 
 		/* Next loop starts right above this loop */
 		chunk_low = chunk_high;
+		snek_gc_count(overflow);
 	}
 
 	snek_top = top;
+#ifdef SNEK_INCREMENTAL_MARK
+	/* Start marking again once half of the free space is used */
+	snek_mark_trigger = top + (SNEK_POOL_SIZE - top) / 2;
+#endif
+#ifdef SNEK_GENERATIONAL
+	/* Everything left in the nursery has survived and is now old */
+	snek_last_top = top;
+	snek_remember_num = 0;
+	snek_collect_minor = false;
+#else
 	if (style == SNEK_COLLECT_FULL)
 		snek_last_top = top;
+#endif
+
+#ifdef SNEK_GC_STATS
+	if (style == SNEK_COLLECT_FULL)
+		snek_gc_stats.full++;
+	else
+		snek_gc_stats.incremental++;
+	uint32_t pause = SNEK_GC_TIME() - start;
+	snek_gc_stats.pause += pause;
+	if (pause > snek_gc_stats.pause_max)
+		snek_gc_stats.pause_max = pause;
+#endif
+
+	SNEK_COLLECT_HOOK_STOP;
+	debug_memory("%d free\n", SNEK_POOL_SIZE - snek_top);
+	return SNEK_POOL_SIZE - snek_top;
+}
+
+#ifdef SNEK_IMAGE
+/*
+ * Compact the heap and record the root values so that the first
+ * image->top bytes of the pool can be saved in the image
+ */
+bool
+snek_mem_image_save(snek_image_t *image)
+{
+	snek_offset_t i;
 
-	debug_memory("%d free\n", SNEK_POOL - snek_top);
-	return SNEK_POOL - snek_top;
+	if (SNEK_ROOT > SNEK_IMAGE_NROOT)
+		return false;
+	snek_collect(SNEK_COLLECT_FULL);
+	image->top = snek_top;
+	image->nroot = SNEK_ROOT;
+	for (i = 0; i < (snek_offset_t) SNEK_ROOT; i++) {
+		void **a = SNEK_ROOT_ADDR(&snek_root[i]);
+		if (SNEK_ROOT_TYPE(&snek_root[i]))
+			image->root[i] = snek_pool_offset(*a);
+		else
+			image->root[i] = ((snek_poly_t *) (void *) a)->u;
+	}
+	return true;
+}
+
+/*
+ * Replace the heap with the contents of an image. A full collection
+ * afterwards resets the collector state to match the new heap
+ */
+bool
+snek_mem_image_load(const snek_image_t *image)
+{
+	snek_offset_t i;
+
+	if (image->nroot != SNEK_ROOT)
+		return false;
+#ifdef SNEK_DYNAMIC
+	if (image->top > snek_pool_size && !snek_mem_grow(image->top - snek_top))
+		return false;
+#else
+	if (image->top > SNEK_POOL_SIZE)
+		return false;
+#endif
+	for (i = 0; i < (snek_offset_t) SNEK_ROOT; i++) {
+		void **a = SNEK_ROOT_ADDR(&snek_root[i]);
+		if (SNEK_ROOT_TYPE(&snek_root[i]))
+			*a = NULL;
+		else
+			*(snek_poly_t *) (void *) a = SNEK_NULL;
+	}
+	snek_stackp = 0;
+	snek_top = 0;
+#ifdef SNEK_INCREMENTAL_MARK
+	snek_marking = false;
+#endif
+#ifdef SNEK_ROM
+	snek_rom = (const uint8_t *) (image + 1);
+	snek_rom_size = image->rom;
+#endif
+	memcpy(snek_pool, (const uint8_t *) (image + 1) + image->rom, image->top);
+	snek_top = image->top;
+	for (i = 0; i < (snek_offset_t) SNEK_ROOT; i++) {
+		void **a = SNEK_ROOT_ADDR(&snek_root[i]);
+		if (SNEK_ROOT_TYPE(&snek_root[i]))
+			*a = snek_pool_addr(image->root[i]);
+		else
+			((snek_poly_t *) (void *) a)->u = image->root[i];
+	}
+	snek_last_top = 0;
+	snek_collect(SNEK_COLLECT_FULL);
+	return true;
 }
+#endif
 
 /*
  * Mark interfaces for objects
@@ -484,10 +1203,33 @@ snek_mark_blob(void *addr, snek_offset_t size)
 #endif
 
 	offset = pool_offset(addr);
+#ifdef SNEK_GC_STATS
+	if (snek_census) {
+		if (busy(offset))
+			return true;
+		mark(offset);
+		snek_census_live[snek_census_type] += snek_size_round(size);
+		return false;
+	}
+#endif
+#ifdef SNEK_INCREMENTAL_MARK
+	if (snek_marking) {
+		if (extent(offset))
+			return true;
+		set_extent(offset, size, true);
+		return false;
+	}
+#endif
 	if (busy(offset))
 		return true;
 	debug_memory("\tmark %d size %d\n", offset, size);
 	mark(offset);
+#ifdef SNEK_CHUNK_BORROW
+	if (snek_collect_extent) {
+		set_extent(offset, size, true);
+		return false;
+	}
+#endif
 	note_chunk(offset, size);
 	return false;
 }
@@ -504,6 +1246,14 @@ type_name(const struct snek_mem *type)
 		return "frame";
 	if (type == &snek_name_mem)
 		return "name";
+#ifdef SNEK_STRING_BUILDER
+	if (type == &snek_builder_mem)
+		return "builder";
+#endif
+#ifdef SNEK_NAME_HASH
+	if (type == &snek_name_table_mem)
+		return "name_table";
+#endif
 	snek_type_t t = (type - _snek_mems) + 1;
 	switch (t) {
 	case snek_list:
@@ -519,11 +1269,46 @@ type_name(const struct snek_mem *type)
 }
 #endif
 
+#ifdef SNEK_GC_STATS
+static uint8_t
+census_type(const struct snek_mem *type)
+{
+	if (type == &snek_name_mem)
+		return 0;
+#ifdef SNEK_NAME_HASH
+	if (type == &snek_name_table_mem)
+		return 0;
+#endif
+	if (type == &snek_frame_mem)
+		return 1;
+	if (type == &snek_code_mem || type == &snek_compile_mem)
+		return 2;
+#ifdef SNEK_STRING_BUILDER
+	if (type == &snek_builder_mem)
+		return SNEK_CENSUS_LIST + (snek_string - 1);
+#endif
+	return SNEK_CENSUS_LIST + (type - _snek_mems);
+}
+#endif
+
 bool
 snek_mark_block_addr(const struct snek_mem *type, void *addr)
 {
 	bool ret;
+	if (snek_is_rom_addr(addr))
+		return true;
+#ifdef SNEK_GENERATIONAL
+	if (snek_collect_skip(type, addr))
+		return true;
+#endif
+#ifdef SNEK_GC_STATS
+	if (snek_census)
+		snek_census_type = census_type(type);
+#endif
 	ret = snek_mark_blob(addr, snek_size(type, addr));
+#ifdef SNEK_GC_STATS
+	snek_census_type = SNEK_CENSUS_LIST;
+#endif
 	if (!ret) {
 		debug_memory("\tmark %s %d %d\n", type_name(type), pool_offset(addr), snek_size(type, addr));
 	}
@@ -538,15 +1323,23 @@ snek_mark_addr(const struct snek_mem *type, void *addr)
 {
 	bool ret;
 	ret = snek_mark_block_addr(type, addr);
-	if (!ret)
+	if (!ret) {
+#ifdef SNEK_INCREMENTAL_MARK
+		if (snek_marking) {
+			/* Strings have no contents to scan */
+			if (type != snek_mems(snek_string))
+				snek_gray_push(type, addr);
+		} else
+#endif
 		SNEK_MEM_MARK(type)(addr);
+	}
 	return ret;
 }
 
 bool
 snek_mark_offset(const struct snek_mem *type, snek_offset_t offset)
 {
-	if (snek_offset_is_none(offset))
+	if (snek_offset_is_none(offset) || snek_offset_is_rom(offset))
 		return true;
 	return snek_mark_addr(type, pool_addr(offset));
 }
@@ -592,6 +1385,9 @@ snek_poly_mark(snek_poly_t p)
 
 	addr = snek_ref(p);
 
+	if (snek_is_rom_addr(addr))
+		return true;
+
 	if (type == snek_list) {
 		debug_memory("\tmark list %d\n", pool_offset(addr));
 	}
@@ -602,6 +1398,10 @@ snek_poly_mark(snek_poly_t p)
 #endif
 
 	ret = snek_mark_addr(snek_mems(type), addr);
+#ifdef SNEK_INCREMENTAL_MARK
+	if (snek_marking)
+		return ret;
+#endif
 	if (!ret && type == snek_list)
 		note_list(addr, addr);
 
@@ -625,6 +1425,13 @@ move_map(snek_offset_t offset)
 
 	chunk = find_chunk(offset);
 
+#ifdef SNEK_EXTENT
+	/* Chunks built from the extent map may hold several objects */
+	if (chunk == chunk_last || snek_chunk[chunk].old_offset != offset) {
+		chunk--;
+		return snek_chunk[chunk].new_offset + (offset - snek_chunk[chunk].old_offset);
+	}
+#endif
 	return snek_chunk[chunk].new_offset;
 }
 
@@ -634,7 +1441,7 @@ snek_move_block_offset(void *ref)
 	snek_offset_t	offset;
 
 	memcpy(&offset, ref, sizeof (snek_offset_t));
-	if (snek_offset_is_none(offset))
+	if (snek_offset_is_none(offset) || snek_offset_is_rom(offset))
 		return true;
 
 	offset = move_map(offset);
@@ -670,6 +1477,12 @@ bool
 snek_move_addr(const struct snek_mem *type, void **ref)
 {
 	bool ret;
+	if (snek_is_rom_addr(*ref))
+		return true;
+#ifdef SNEK_GENERATIONAL
+	if (snek_collect_skip(type, *ref))
+		return true;
+#endif
 	ret = snek_move_block_addr(ref);
 	if (!ret)
 		SNEK_MEM_MOVE(type)(*ref);
@@ -681,6 +1494,12 @@ bool
 snek_move_offset(const struct snek_mem *type, snek_offset_t *ref)
 {
 	bool ret;
+	if (snek_offset_is_rom(*ref))
+		return true;
+#ifdef SNEK_GENERATIONAL
+	if (!snek_offset_is_none(*ref) && snek_collect_skip(type, pool_addr(*ref)))
+		return true;
+#endif
 	ret = snek_move_block_offset(ref);
 	if (!ret)
 		SNEK_MEM_MOVE(type)(pool_addr(*ref));
@@ -699,6 +1518,9 @@ snek_poly_move(snek_poly_t *ref)
 
 	orig_addr = addr = snek_ref(p);
 
+	if (snek_is_rom_addr(addr))
+		return true;
+
 	if (type == snek_list) {
 		debug_memory("\tmove list %d\n", pool_offset(addr));
 	}
@@ -719,15 +1541,147 @@ snek_poly_move(snek_poly_t *ref)
 	return ret;
 }
 
+#ifdef SNEK_FREE_LIST
+void
+snek_free(void *addr, snek_offset_t size)
+{
+	snek_offset_t	offset = pool_offset(addr);
+
+	size = snek_size_round(size);
+#ifdef SNEK_INCREMENTAL_MARK
+	/* Marking may already have reached the block */
+	if (snek_marking)
+		return;
+#endif
+#ifdef SNEK_GENERATIONAL
+	/* Minor collections don't look below snek_last_top */
+	if (offset < snek_last_top)
+		return;
+#endif
+	if (offset + size == snek_top) {
+		debug_memory("Free %d size %d at top\n", offset, size);
+		snek_top = offset;
+		return;
+	}
+	if (size > SNEK_FREE_LIST)
+		return;
+	debug_memory("Free %d size %d\n", offset, size);
+	*(snek_offset_t *) addr = *snek_free_class(size);
+	*snek_free_class(size) = offset;
+}
+#endif
+
+#ifdef SNEK_GC_STATS
+/*
+ * Measure the reachable objects by marking the heap without
+ * disturbing any collection in progress
+ */
+static void
+snek_census_take(void)
+{
+#ifdef SNEK_INCREMENTAL_MARK
+	bool marking = snek_marking;
+	snek_marking = false;
+#endif
+	memset(snek_census_live, '\0', sizeof (snek_census_live));
+	snek_census = true;
+	walk(snek_mark_ref, snek_poly_mark_ref);
+	snek_census = false;
+#ifdef SNEK_INCREMENTAL_MARK
+	snek_marking = marking;
+#endif
+}
+
+static bool
+snek_gc_stats_key(const char *name)
+{
+	snek_offset_t len = strlen(name);
+	char *key = snek_string_alloc(len);
+
+	if (!key)
+		return false;
+	memcpy(key, name, len);
+	snek_stack_push(snek_string_to_poly(key));
+	return true;
+}
+
+static bool
+snek_gc_stats_push(const char *name, float value)
+{
+	if (!snek_gc_stats_key(name))
+		return false;
+	snek_stack_push(snek_float_to_poly(value));
+	return true;
+}
+
+snek_poly_t
+snek_builtin_gc_stats(void)
+{
+	uint8_t	t;
+
+	snek_census_take();
+
+	/* Build the nested dict of live bytes by type first */
+	if (!snek_gc_stats_key("live"))
+		return SNEK_NULL;
+	for (t = 0; t < SNEK_CENSUS_TYPES; t++)
+		if (!snek_gc_stats_push(snek_census_name[t], (float) snek_census_live[t]))
+			return SNEK_NULL;
+	snek_stack_push(snek_list_imm(SNEK_CENSUS_TYPES * 2, snek_list_dict));
+
+	if (!snek_gc_stats_push("allocated", (float) snek_gc_stats.allocated) ||
+	    !snek_gc_stats_push("full", (float) snek_gc_stats.full) ||
+	    !snek_gc_stats_push("incremental", (float) snek_gc_stats.incremental) ||
+	    !snek_gc_stats_push("pause", (float) snek_gc_stats.pause / 1e6f) ||
+	    !snek_gc_stats_push("pause_max", (float) snek_gc_stats.pause_max / 1e6f) ||
+	    !snek_gc_stats_push("overflow", (float) snek_gc_stats.overflow) ||
+	    !snek_gc_stats_push("heap", (float) SNEK_POOL_SIZE) ||
+	    !snek_gc_stats_push("used", (float) snek_top))
+		return SNEK_NULL;
+	return snek_list_imm(9 * 2, snek_list_dict);
+}
+#endif
+
 void *
 snek_alloc(snek_offset_t size)
 {
 	void	*addr;
 
 	size = snek_size_round(size);
-	if (SNEK_POOL - snek_top < size &&
+#ifdef SNEK_GC_STATS
+	snek_gc_stats.allocated += size;
+#endif
+#ifdef SNEK_INCREMENTAL_MARK
+	if (snek_marking)
+		snek_mark_step();
+	else if (snek_mark_trigger && snek_top >= snek_mark_trigger)
+		snek_mark_start();
+#endif
+#ifdef SNEK_FREE_LIST
+	if (size && size <= SNEK_FREE_LIST
+#ifdef SNEK_INCREMENTAL_MARK
+	    && !snek_marking
+#endif
+		)
+	{
+		snek_offset_t *head = snek_free_class(size);
+
+		if (!snek_offset_is_none(*head)) {
+			addr = pool_addr(*head);
+			*head = *(snek_offset_t *) addr;
+			memset(addr, '\0', size);
+			debug_memory("Alloc %d size %d from free list\n", pool_offset(addr), size);
+			return addr;
+		}
+	}
+#endif
+	if (SNEK_POOL_SIZE - snek_top - snek_gray_spill() < size &&
 	    snek_collect(SNEK_COLLECT_INCREMENTAL) < size &&
-	    snek_collect(SNEK_COLLECT_FULL) < size)
+	    snek_collect(SNEK_COLLECT_FULL) < size
+#ifdef SNEK_DYNAMIC
+	    && !snek_mem_grow(size)
+#endif
+		)
 	{
 		snek_error_0("out of memory");
 		return NULL;
@@ -744,7 +1698,10 @@ snek_pool_addr(snek_offset_t offset)
 {
 	if (snek_offset_is_none(offset))
 		return NULL;
-
+#ifdef SNEK_ROM
+	if (offset >= SNEK_ROM_OFFSET)
+		return snek_rom_addr(offset);
+#endif
 	return pool_addr(offset);
 }
 
@@ -753,6 +1710,10 @@ snek_pool_offset(const void *addr)
 {
 	if (addr == NULL)
 		return SNEK_OFFSET_NONE;
+#ifdef SNEK_ROM
+	if (snek_is_rom_addr(addr))
+		return snek_rom_offset(addr);
+#endif
 	return pool_offset(addr);
 }
 
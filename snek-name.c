@@ -14,7 +14,9 @@
 
 #include "snek.h"
 
+#ifndef SNEK_NAME_HASH
 snek_name_t *snek_names;
+#endif
 snek_id_t   snek_id = SNEK_BUILTIN_END;
 
 #define SNEK_BUILTIN_DATA
@@ -46,6 +48,67 @@ tyepdef uint32_t snek_bi_index_t;
 
 #define SNEK_BUILTIN_ID(i)	SNEK_BUILTIN_NAMES(i)
 
+#ifdef SNEK_NAME_HASH
+
+/*
+ * FNV-1a, which must match name_hash in snek-builtin.py
+ */
+static uint32_t
+snek_name_hash(const char *name)
+{
+	uint32_t h = 2166136261UL;
+	uint8_t c;
+
+	while ((c = (uint8_t) *name++))
+		h = (h ^ c) * 16777619UL;
+	return h;
+}
+
+#ifdef SNEK_BUILTIN_HASH_SIZE
+#define SNEK_BUILTIN_HASH_SLOT(h, d)	(((uint32_t) (((h) ^ ((d) * 0x9e3779b9UL)) * 0x85ebca6bUL) >> 16) % SNEK_BUILTIN_HASH_SIZE)
+#endif
+
+#endif
+
+#ifdef SNEK_BUILTIN_HASH_SIZE
+
+/*
+ * The builtin names are indexed by a perfect hash computed in
+ * snek-builtin.py, so a single probe and compare finds any builtin
+ */
+static snek_id_t
+snek_name_id_builtin(char *name, uint32_t h, bool *keyword)
+{
+	uint8_t d = snek_builtin_hash_disp[h % SNEK_BUILTIN_HASH_BUCKETS];
+	snek_id_t id = snek_builtin_hash[SNEK_BUILTIN_HASH_SLOT(h, d)];
+
+	if (!id)
+		return 0;
+
+	snek_bi_index_t i = snek_builtin_names_offset[id - 1];
+
+	if (SNEK_BUILTIN_NAMES_CMP(name, (const char *) &snek_builtin_names[i]) != 0)
+		return 0;
+	if (id >= SNEK_BUILTIN_END) {
+		id = SNEK_BUILTIN_ID(i - 1);
+		*keyword = true;
+	} else {
+		*keyword = false;
+	}
+	return id;
+}
+
+static const char *
+snek_name_string_builtin(snek_id_t id)
+{
+	if (id >= SNEK_BUILTIN_END)
+		return NULL;
+
+	return snek_builtin_names_return(&snek_builtin_names[snek_builtin_names_offset[id - 1]]);
+}
+
+#else
+
 static snek_id_t
 snek_name_id_builtin(char *name, bool *keyword)
 {
@@ -87,6 +150,165 @@ snek_name_string_builtin(snek_id_t id)
 	return snek_builtin_names_return(&snek_builtin_names[i]);
 }
 
+#endif
+
+#ifdef SNEK_NAME_HASH
+
+/*
+ * User names are found through an open-addressed index stored
+ * after the array of name offsets; the index holds id -
+ * SNEK_BUILTIN_END so that zero marks an empty entry
+ */
+
+snek_name_table_t *snek_name_table;
+
+#define SNEK_NAME_TABLE_MIN	16
+
+#define snek_name_count()		((snek_offset_t) (snek_id - SNEK_BUILTIN_END))
+#define snek_name_table_index(t)	((t)->names + (t)->nalloc)
+#define snek_name_table_nindex(t)	((snek_offset_t) ((t)->nalloc << 1))
+
+static void
+snek_name_table_insert(snek_name_table_t *t, uint32_t h, snek_offset_t n)
+{
+	snek_offset_t *index = snek_name_table_index(t);
+	snek_offset_t mask = snek_name_table_nindex(t) - 1;
+	snek_offset_t i;
+
+	for (i = (snek_offset_t) h & mask; index[i]; i = (i + 1) & mask)
+		;
+	index[i] = n;
+}
+
+static bool
+snek_name_table_grow(void)
+{
+	snek_offset_t nalloc = SNEK_NAME_TABLE_MIN;
+	snek_offset_t n, count = snek_name_count();
+
+	if (snek_name_table)
+		nalloc = snek_name_table->nalloc << 1;
+	snek_name_table_t *t = snek_alloc(sizeof (snek_name_table_t) + 3 * nalloc * sizeof (snek_offset_t));
+	if (!t)
+		return false;
+	t->nalloc = nalloc;
+	for (n = 0; n < count; n++) {
+		t->names[n] = snek_name_table->names[n];
+		snek_name_table_insert(t, snek_name_hash(((snek_name_t *) snek_pool_addr(t->names[n]))->name), n + 1);
+	}
+	snek_name_table = t;
+	return true;
+}
+
+snek_id_t
+snek_name_id(char *name, bool *keyword)
+{
+	uint32_t h = snek_name_hash(name);
+	snek_id_t id;
+
+#ifdef SNEK_BUILTIN_HASH_SIZE
+	if ((id = snek_name_id_builtin(name, h, keyword)))
+#else
+	if ((id = snek_name_id_builtin(name, keyword)))
+#endif
+		return id;
+
+	*keyword = false;
+
+	snek_name_table_t *t = snek_name_table;
+	if (t) {
+		snek_offset_t *index = snek_name_table_index(t);
+		snek_offset_t mask = snek_name_table_nindex(t) - 1;
+		snek_offset_t i, n;
+
+		for (i = (snek_offset_t) h & mask; (n = index[i]); i = (i + 1) & mask) {
+			snek_name_t *name_n = snek_pool_addr(t->names[n - 1]);
+			if (!strcmp(name_n->name, name))
+				return (snek_id_t) (n + SNEK_BUILTIN_END);
+		}
+	}
+
+	if ((!t || snek_name_count() == t->nalloc) && !snek_name_table_grow())
+		return SNEK_ID_NONE;
+
+	snek_name_t *n = snek_alloc(sizeof (snek_name_t) + strlen(name) + 1);
+	if (!n)
+		return SNEK_ID_NONE;
+	strcpy(n->name, name);
+	n->next = SNEK_OFFSET_NONE;
+	t = snek_name_table;
+	t->names[snek_name_count()] = snek_pool_offset(n);
+	snek_id++;
+	snek_name_table_insert(t, h, snek_name_count());
+	return snek_id;
+}
+
+const char *
+snek_name_string(snek_id_t id)
+{
+	const char *b;
+
+	if ((b = snek_name_string_builtin(id)))
+		return b;
+
+	if (id <= SNEK_BUILTIN_END || id > snek_id)
+		return NULL;
+
+	snek_name_t *n = snek_pool_addr(snek_name_table->names[id - SNEK_BUILTIN_END - 1]);
+	return n->name;
+}
+
+static snek_offset_t
+snek_name_table_size(void *addr)
+{
+	snek_name_table_t *t = addr;
+
+	return (snek_offset_t) (sizeof (snek_name_table_t) + 3 * t->nalloc * sizeof (snek_offset_t));
+}
+
+/*
+ * A table replaced by snek_name_table_grow may still be scanned by
+ * the incremental marker, so don't look past its end
+ */
+static snek_offset_t
+snek_name_table_count(snek_name_table_t *t)
+{
+	snek_offset_t count = snek_name_count();
+
+	if (count > t->nalloc)
+		count = t->nalloc;
+	return count;
+}
+
+static void
+snek_name_table_mark(void *addr)
+{
+	snek_name_table_t *t = addr;
+	snek_offset_t n, count = snek_name_table_count(t);
+
+	for (n = 0; n < count; n++)
+		snek_mark_offset(&snek_name_mem, t->names[n]);
+}
+
+static void
+snek_name_table_move(void *addr)
+{
+	snek_name_table_t *t = addr;
+	snek_offset_t n, count = snek_name_table_count(t);
+
+	for (n = 0; n < count; n++)
+		snek_move_offset(&snek_name_mem, &t->names[n]);
+}
+
+const snek_mem_t SNEK_MEM_DECLARE(snek_name_table_mem) = {
+	.size = snek_name_table_size,
+	.mark = snek_name_table_mark,
+	.move = snek_name_table_move,
+	SNEK_MEM_DECLARE_NAME("name_table")
+};
+
+#else
+
 snek_id_t
 snek_name_id(char *name, bool *keyword)
 {
@@ -134,6 +356,8 @@ snek_name_string(snek_id_t match_id)
 	return NULL;
 }
 
+#endif
+
 static snek_offset_t
 snek_name_size(void *addr)
 {
@@ -18,6 +18,7 @@ bool snek_interactive;
 
 bool snek_parse_middle;
 static uint8_t for_depth;
+static uint8_t range_depth;
 
 static bool snek_print_val;
 
@@ -162,12 +163,20 @@ _value_push_id(snek_id_t id, const char *file, int line)
 static inline void binop_first(void)
 {
 	snek_code_set_push(snek_code_prev_insn());
+#ifdef SNEK_FOLD
+	value_push_offset(snek_code_prev_insn());
+#endif
 	value_push_op(snek_token_val.op);
 }
 
 static inline void binop_second(void)
 {
-	snek_code_add_op(value_pop().op);
+	snek_op_t op = value_pop().op;
+#ifdef SNEK_FOLD
+	if (snek_code_fold_binop(value_pop().offset, op))
+		return;
+#endif
+	snek_code_add_op(op);
 }
 
 static inline void add_op_lvalue(void)
@@ -179,6 +188,40 @@ static inline void add_op_lvalue(void)
 	snek_code_add_op_id(op, id);
 }
 
+/*
+ * Patch the branch around an 'if' or 'elif' body. When the
+ * condition is constant, either the body or the alternatives can
+ * never run, so their code is removed along with the test. Returns
+ * where the remaining code for the statement starts
+ */
+static inline snek_offset_t patch_if(void)
+{
+	snek_offset_t elif_stats_off = value_pop().offset;
+	snek_offset_t if_expr_off = value_pop().offset;
+	snek_offset_t if_expr_start = value_pop().offset;
+
+#ifdef SNEK_FOLD
+	float cond;
+
+	if (snek_code_constant(if_expr_start, if_expr_off, &cond)) {
+		if (cond != 0.0f) {
+			/* Any alternatives follow a branch past them */
+			if (elif_stats_off < snek_code_current())
+				snek_code_delete(elif_stats_off - (1 + sizeof (snek_offset_t)),
+						 snek_code_current());
+			snek_code_delete(if_expr_start, if_expr_off + 1 + sizeof (snek_offset_t));
+		} else {
+			snek_code_delete(if_expr_start, elif_stats_off);
+		}
+		return if_expr_start;
+	}
+#else
+	(void) if_expr_start;
+#endif
+	snek_code_patch_branch(if_expr_off, elif_stats_off);
+	return if_expr_off;
+}
+
 static inline void patch_loop(void)
 {
 	snek_offset_t while_else_stat_off = value_pop().offset;
@@ -192,20 +235,56 @@ static inline void patch_loop(void)
 	snek_code_patch_forward(while_off, loop_end_off, snek_forward_break, snek_code_current());
 }
 
+/*
+ * Check whether the innermost 'for' loop runs over a range, which
+ * keeps its state on the value stack while the body runs
+ */
+static inline bool for_is_range(void)
+{
+	snek_offset_t top_off = value_stack[value_stack_p - 1].offset;
+
+	return (snek_compile[top_off] & ~snek_op_push) == snek_op_range_step;
+}
+
+/*
+ * Pop the state of any enclosing range loops before returning
+ */
+static inline void add_return(void)
+{
+	uint8_t r;
+
+	for (r = 0; r < range_depth; r++)
+		snek_code_add_op(snek_op_range_drop);
+	snek_code_add_op(snek_op_return);
+}
+
 static inline void short_second(void)
 {
 	snek_code_patch_branch(value_pop().offset, snek_code_current());
 	snek_code_add_op(snek_op_nop);
 }
 
+static inline void unop_push(snek_op_t op)
+{
+#ifdef SNEK_FOLD
+	value_push_offset(snek_code_current());
+#endif
+	value_push_op(op);
+}
+
 static inline void unop_first(void)
 {
-	value_push_op(snek_token_val.op);
+	unop_push(snek_token_val.op);
 }
 
 static inline void unop_second(void)
 {
-	snek_code_add_op(value_pop().op);
+	snek_op_t op = value_pop().op;
+#ifdef SNEK_FOLD
+	if (snek_code_fold_unop(value_pop().offset, op))
+		return;
+#endif
+	snek_code_add_op(op);
 }
 
 #define PARSE_CODE
@@ -226,6 +305,7 @@ snek_parse(void)
 		snek_parse_middle = false;
 		value_stack_p = 0;
 		for_depth = 0;
+		range_depth = 0;
 
 		/* Reset codegen state */
 		snek_code_reset();
@@ -19,7 +19,12 @@ snek_ref(snek_poly_t poly)
 {
 	if (snek_is_null(poly))
 		return NULL;
-	return snek_pool + snek_poly_to_offset(poly);
+	snek_offset_t offset = snek_poly_to_offset(poly);
+#ifdef SNEK_ROM
+	if (offset >= SNEK_ROM_OFFSET)
+		return snek_rom_addr(offset);
+#endif
+	return snek_pool + offset;
 }
 
 snek_poly_t
@@ -27,6 +32,10 @@ snek_poly(const void *addr, snek_type_t type)
 {
 	if (addr == NULL)
 		return SNEK_NULL;
+#ifdef SNEK_ROM
+	if (snek_is_rom_addr(addr))
+		return snek_offset_to_poly(snek_rom_offset(addr), type);
+#endif
 	return snek_offset_to_poly((const uint8_t *) addr - snek_pool, type);
 }
 
@@ -44,14 +53,6 @@ snek_soffset_to_poly(snek_soffset_t s)
 	return snek_float_to_poly(s);
 }
 
-static bool
-snek_is_float(snek_poly_t v)
-{
-	if ((v.u & SNEK_EXPONENT_MASK) != SNEK_EXPONENT_MASK || v.u == SNEK_NINF)
-		return true;
-	return false;
-}
-
 snek_poly_t
 snek_bool_to_poly(bool b)
 {
@@ -109,7 +110,7 @@ snek_poly_true(snek_poly_t a)
 	case snek_list:
 		return snek_poly_to_list(a)->size != 0;
 	case snek_string:
-		return strlen(snek_poly_to_string(a)) != 0;
+		return snek_poly_to_string(a)[0] != '\0';
 	default:
 		return false;
 	}
@@ -122,7 +123,7 @@ snek_poly_len(snek_poly_t a)
 	snek_list_t *al;
 	switch (snek_poly_type(a)) {
 	case snek_string:
-		return strlen(snek_poly_to_string(a));
+		return snek_string_len(snek_poly_to_string(a));
 	case snek_list:
 		al = snek_poly_to_list(a);
 		len = al->size;
@@ -137,6 +137,10 @@ snek_poly_format(snek_buf_t *buf, snek_poly_t a, char format)
 		snek_list_t *list = snek_poly_to_list(a);
 		snek_list_type_t type = snek_list_type(list);
 		snek_offset_t size = list->size;
+#ifdef SNEK_DICT_HASH
+		if (type == snek_list_dict)
+			snek_dict_sort(list);
+#endif
 
 		snek_stack_push_list(list);
 		buf->put_c(snek_list_open(type), closure);
@@ -14,12 +14,59 @@
 
 #include "snek.h"
 
+/*
+ * Allocate a string of 'len' bytes and return the text, which the
+ * caller fills in. The terminating NUL is already set
+ */
+char *
+snek_string_alloc(snek_offset_t len)
+{
+	char *new = snek_alloc(SNEK_STRING_TEXT + len + 1);
+	if (!new)
+		return NULL;
+#ifdef SNEK_STRING_LEN
+	((snek_string_t *) new)->len = len;
+#endif
+	new += SNEK_STRING_TEXT;
+	new[len] = '\0';
+	return new;
+}
+
+#ifdef SNEK_STRING_CHARS
+/*
+ * One-character strings are made once and then shared. The table is
+ * a root, so they stay alive, and entries which are not yet strings
+ * have not been made
+ */
+snek_list_t	*snek_string_chars;
+#endif
+
 snek_poly_t
 snek_string_make(char c)
 {
-	char *new = snek_alloc(2);
-	if (new)
-		new[0] = c;
+#ifdef SNEK_STRING_CHARS
+	uint8_t		i = (uint8_t) c;
+	snek_poly_t	*data;
+
+	if (!snek_string_chars)
+		snek_string_chars = snek_list_make(256, snek_list_list);
+	if (snek_string_chars) {
+		data = snek_list_data(snek_string_chars);
+		if (snek_poly_type(data[i]) == snek_string)
+			return data[i];
+	}
+#endif
+	char *new = snek_string_alloc(c != '\0');
+	if (!new)
+		return SNEK_NULL;
+	new[0] = c;
+#ifdef SNEK_STRING_CHARS
+	if (snek_string_chars) {
+		snek_remember(snek_string_chars);
+		data = snek_list_data(snek_string_chars);
+		data[i] = snek_string_to_poly(new);
+	}
+#endif
 	return snek_string_to_poly(new);
 }
 
@@ -27,9 +74,10 @@ snek_string_make(char c)
 snek_poly_t
 snek_string_build(const char *s)
 {
-	char *new = snek_alloc(strlen(s) + 1);
+	snek_offset_t len = strlen(s);
+	char *new = snek_string_alloc(len);
 	if (new)
-		strcpy(new, s);
+		memcpy(new, s, len);
 	return snek_string_to_poly(new);
 }
 #endif
@@ -38,7 +86,7 @@ snek_poly_t
 snek_string_get(char *string, snek_poly_t p, bool report_error)
 {
 	snek_soffset_t so = snek_poly_get_soffset(p);
-	snek_offset_t len = strlen(string);
+	snek_offset_t len = snek_string_len(string);
 	snek_offset_t o;
 
 	o = (snek_offset_t) so;
@@ -52,20 +100,19 @@ snek_string_get(char *string, snek_poly_t p, bool report_error)
 	return snek_string_make(string[o]);
 }
 
-static char *
+char *
 snek_string_catn(char *a, snek_offset_t aoff, snek_offset_t alen,
-		 char *b, snek_offset_t boff, snek_offset_t blen)
+		 const char *b, snek_offset_t boff, snek_offset_t blen)
 {
 	char *new;
 	snek_stack_push_string(a);
 	snek_stack_push_string(b);
-	new = snek_alloc(alen + blen + 1);
+	new = snek_string_alloc(alen + blen);
 	b = snek_stack_pop_string(b);
 	a = snek_stack_pop_string(a);
 	if (new) {
 		memcpy(new, a + aoff, alen);
 		memcpy(new + alen, b + boff, blen);
-		new[alen+blen] = '\0';
 	}
 	return new;
 }
@@ -73,8 +120,8 @@ snek_string_catn(char *a, snek_offset_t aoff, snek_offset_t alen,
 snek_poly_t
 snek_string_cat(char *a, char *b)
 {
-	return snek_string_to_poly(snek_string_catn(a, 0, strlen(a),
-						    b, 0, strlen(b)));
+	return snek_string_to_poly(snek_string_catn(a, 0, snek_string_len(a),
+						    b, 0, snek_string_len(b)));
 }
 
 #ifndef SNEK_NO_SLICE
@@ -83,16 +130,22 @@ snek_string_slice(char *a, snek_slice_t *slice)
 {
 	if (slice->identity)
 		return a;
+#ifdef SNEK_STRING_CHARS
+	if (slice->count == 1)
+		return snek_poly_to_string(snek_string_make(a[slice->pos]));
+#endif
 
 	snek_stack_push_string(a);
-	char	*r = snek_alloc(slice->count + 1);
+	char	*r = snek_string_alloc(slice->count);
 	a = snek_stack_pop_string(a);
 	if (!r)
 		return NULL;
 	snek_offset_t i = 0;
-	for (; snek_slice_test(slice); snek_slice_step(slice))
-		r[i++] = a[slice->pos];
-	r[i] = '\0';
+	if (slice->stride == 1)
+		memcpy(r, a + slice->pos, slice->count);
+	else
+		for (; snek_slice_test(slice); snek_slice_step(slice))
+			r[i++] = a[slice->pos];
 	return r;
 }
 #endif
@@ -100,15 +153,16 @@ snek_string_slice(char *a, snek_slice_t *slice)
 snek_poly_t
 snek_string_times(char *a, snek_soffset_t b)
 {
-	snek_offset_t alen = strlen(a);
-	char *s = snek_alloc(alen * b + 1);
+	snek_offset_t alen = snek_string_len(a);
+	snek_stack_push_string(a);
+	char *s = snek_string_alloc(alen * b);
+	a = snek_stack_pop_string(a);
 	if (s) {
 		char *t = s;
 		while (b--) {
 			memcpy(t, a, alen);
 			t += alen;
 		}
-		*t = '\0';
 	}
 	return snek_string_to_poly(s);
 }
@@ -122,21 +176,116 @@ snek_next_format(char *a)
 	return strlen(a);
 }
 
+#ifdef SNEK_STRING_BUILDER
+/*
+ * Interpolation collects its result in a builder, a buffer with
+ * spare space which doubles as it fills, so that building a string
+ * takes linear time. The result is copied to a new string at the end
+ */
+
+snek_builder_t	*snek_builder;
+
+#define SNEK_BUILDER_MIN	32
+
+static snek_offset_t
+snek_builder_size(void *addr)
+{
+	snek_builder_t *b = addr;
+	return (snek_offset_t) sizeof (snek_builder_t) + b->alloc;
+}
+
+const snek_mem_t SNEK_MEM_DECLARE(snek_builder_mem) = {
+	.size = snek_builder_size,
+	.mark = snek_string_mark_move,
+	.move = snek_string_mark_move,
+	SNEK_MEM_DECLARE_NAME("builder")
+};
 
+static snek_builder_t *
+snek_builder_reserve(snek_offset_t add)
+{
+	snek_builder_t *old = snek_builder;
+	snek_offset_t len = old ? old->len : 0;
+	snek_offset_t alloc = old ? old->alloc : SNEK_BUILDER_MIN;
+
+	if (old && alloc - len >= add)
+		return old;
+	while (alloc - len < add)
+		alloc <<= 1;
+
+	snek_builder_t *new = snek_alloc(sizeof (snek_builder_t) + alloc);
+	if (!new)
+		return NULL;
+	old = snek_builder;
+	new->alloc = alloc;
+	if (old) {
+		new->len = old->len;
+		memcpy(new->text, old->text, old->len);
+		snek_free(old, snek_builder_size(old));
+	}
+	snek_builder = new;
+	return new;
+}
+
+static void
+snek_buf_sprintn(char **str_p, const char *s, snek_offset_t off, snek_offset_t len)
+{
+	(void) str_p;
+	snek_stack_push_string(s);
+	snek_builder_t *b = snek_builder_reserve(len);
+	s = snek_stack_pop_string(s);
+	if (b) {
+		memcpy(b->text + b->len, s + off, len);
+		b->len += len;
+	}
+}
+
+static char *
+snek_buf_finish(char **str_p)
+{
+	(void) str_p;
+	snek_offset_t len = snek_builder ? snek_builder->len : 0;
+	char *new = snek_string_alloc(len);
+	snek_builder_t *b = snek_builder;
+
+	snek_builder = NULL;
+	if (b) {
+		if (new)
+			memcpy(new, b->text, len);
+		snek_free(b, snek_builder_size(b));
+	}
+	return new;
+}
+
+static int
+snek_buf_sprintc(int c, void *closure)
+{
+	char ch = c;
+
+	snek_buf_sprintn(closure, &ch, 0, 1);
+	return 0;
+}
+
+static int
+snek_buf_sprints(const char *s, void *closure)
+{
+	snek_buf_sprintn(closure, s, 0, strlen(s));
+	return 0;
+}
+#else
 static char *
 snek_buf_realloc(char **str_p, snek_offset_t add)
 {
 	char *old = *str_p;
 	char *new;
-	snek_offset_t len = old ? strlen(old) : 0;
+	snek_offset_t len = old ? snek_string_len(old) : 0;
 
 	snek_stack_push_string(old);
-	new = snek_alloc(len + add + 1);
+	new = snek_string_alloc(len + add);
 	old = snek_stack_pop_string(old);
 	if (!new)
 		return NULL;
 	memcpy(new, old, len);
-	new[len+add] = '\0';
 	*str_p = new;
 	return new + len;
 }
@@ -167,6 +316,24 @@ snek_buf_sprints(const char *s, void *closure)
 	return 0;
 }
 
+static void
+snek_buf_sprintn(char **str_p, char *s, snek_offset_t off, snek_offset_t len)
+{
+	char *old = *str_p;
+
+	*str_p = snek_string_catn(old, 0, old ? snek_string_len(old) : 0, s, off, len);
+}
+
+/* An empty format leaves no string at all */
+static char *
+snek_buf_finish(char **str_p)
+{
+	if (!*str_p)
+		return snek_string_alloc(0);
+	return *str_p;
+}
+#endif
+
 snek_poly_t
 snek_string_interpolate(char *a, snek_poly_t poly)
 {
@@ -198,8 +365,7 @@ snek_string_interpolate(char *a, snek_poly_t poly)
 		snek_offset_t next = snek_next_format(a + percent) + percent;
 		snek_stack_push(poly);
 		snek_stack_push_string(a);
-		result = snek_string_catn(result, 0, result ? strlen(result) : 0,
-					  a, percent, next-percent);
+		snek_buf_sprintn(&result, a, percent, next - percent);
 		a = snek_stack_pop_string(a);
 		poly = snek_stack_pop();
 		percent = next;
@@ -229,11 +395,36 @@ snek_string_interpolate(char *a, snek_poly_t poly)
 			poly = snek_stack_pop();
 		}
 	}
+	result = snek_buf_finish(&result);
 	if (o != size)
 		return SNEK_INVALID;
 	return snek_string_to_poly(result);
 }
 
+#ifdef SNEK_DYNAMIC
+/*
+ * When the pool can move, a stale pointer can no longer be checked
+ * against it, so constant strings push a placeholder instead
+ */
+void
+snek_stack_push_string(const char *s)
+{
+	if (snek_is_pool_addr(s))
+		snek_stack_push(snek_string_to_poly((char *) s));
+	else
+		snek_stack_push(SNEK_NULL);
+}
+
+char *
+snek_stack_pop_string(const char *s)
+{
+	snek_poly_t p = snek_stack_pop();
+
+	if (snek_is_null(p))
+		return (char *) s;
+	return snek_poly_to_string(p);
+}
+#else
 void
 snek_stack_push_string(const char *s)
 {
@@ -248,12 +439,18 @@ snek_stack_pop_string(const char *s)
 		return snek_poly_to_string(snek_stack_pop());
 	return (char *) s;
 }
+#endif
 
 snek_offset_t
 snek_string_size(void *addr)
 {
+#ifdef SNEK_STRING_LEN
+	snek_string_t *string = addr;
+	return (snek_offset_t) sizeof (snek_string_t) + string->len + 1;
+#else
 	char *string = addr;
 	return (snek_offset_t) strlen(string) + 1;
+#endif
 }
 
 void
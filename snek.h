@@ -20,6 +20,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdarg.h>
+#include <stddef.h>
 #include <string.h>
 #include <math.h>
 
@@ -57,16 +58,40 @@
 #define SNEK_EXPONENT_MASK	0xff800000u
 #define SNEK_NINF		0xff800000u
 
-#if SNEK_POOL <= 65536
+#if SNEK_POOL <= 65536 && !defined(SNEK_DYNAMIC)
 typedef uint16_t	snek_offset_t;
 typedef int16_t		snek_soffset_t;
 #define SNEK_OFFSET_NONE	0xfffcu
 #define SNEK_SOFFSET_NONE	0x7ffc
+#define SNEK_ROM_OFFSET		0x8000u
+#define SNEK_ROM_MAX		0x7ff8u
 #else
 typedef uint32_t	snek_offset_t;
 typedef int32_t		snek_soffset_t;
 #define SNEK_OFFSET_NONE	0xfffffffcu
 #define SNEK_SOFFSET_NONE	0x7ffffffc
+#define SNEK_ROM_OFFSET		0x700000u
+#define SNEK_ROM_MAX		0x100000u
+#endif
+
+/*
+ * With SNEK_ROM, offsets from SNEK_ROM_OFFSET up refer to a
+ * read-only region outside the pool holding code and constant
+ * strings loaded from an image, up to SNEK_ROM_MAX bytes. That
+ * takes part of the offset space away from the pool. The ROM
+ * is filled by the image code, so SNEK_ROM needs SNEK_IMAGE.
+ */
+#ifdef SNEK_ROM
+#ifndef SNEK_IMAGE
+#error SNEK_ROM requires SNEK_IMAGE
+#endif
+#define SNEK_POOL_MAX		SNEK_ROM_OFFSET
+#if !defined(SNEK_DYNAMIC) && SNEK_POOL > SNEK_POOL_MAX
+#error SNEK_POOL too large for SNEK_ROM
+#endif
+#else
+/* The largest pool that offsets can address */
+#define SNEK_POOL_MAX		(SNEK_OFFSET_MASK + SNEK_ALLOC_ROUND)
 #endif
 
 typedef snek_offset_t snek_id_t;
@@ -138,6 +163,10 @@ typedef enum {
 	snek_op_dict,
 #endif
 	snek_op_id,
+#ifdef SNEK_LOCAL_SLOTS
+	snek_op_local,
+	snek_op_assign_local,
+#endif
 
 	snek_op_not,
 	snek_op_uminus,
@@ -157,6 +186,8 @@ typedef enum {
 	snek_op_forward,
 	snek_op_range_start,
 	snek_op_range_step,
+	snek_op_range_break,
+	snek_op_range_drop,
 	snek_op_in_step,
 	snek_op_return,
 
@@ -166,6 +197,49 @@ typedef enum {
 
 	snek_op_nop,
 
+#ifdef SNEK_QUICKEN
+	/* Float-only forms of the common binary operators. snek_exec
+	 * rewrites the generic op to one of these after seeing two
+	 * float operands; each falls back to snek_binary if that
+	 * stops being true.
+	 */
+	snek_op_plus_f,
+	snek_op_minus_f,
+	snek_op_times_f,
+	snek_op_divide_f,
+
+	snek_op_eq_f,
+	snek_op_ne_f,
+	snek_op_gt_f,
+	snek_op_lt_f,
+	snek_op_ge_f,
+	snek_op_le_f,
+#endif
+
+#ifdef SNEK_FUSE
+	/* Superinstructions built by snek_code_finish. The first set
+	 * replaces an int immediate followed by a binary operator,
+	 * the second a comparison followed by branch_false.
+	 */
+	snek_op_plus_i,
+	snek_op_minus_i,
+	snek_op_times_i,
+
+	snek_op_eq_i,
+	snek_op_ne_i,
+	snek_op_gt_i,
+	snek_op_lt_i,
+	snek_op_ge_i,
+	snek_op_le_i,
+
+	snek_op_eq_branch_false,
+	snek_op_ne_branch_false,
+	snek_op_gt_branch_false,
+	snek_op_lt_branch_false,
+	snek_op_ge_branch_false,
+	snek_op_le_branch_false,
+#endif
+
 	snek_op_push = 0x80,
 } __attribute__((packed)) snek_op_t;
 
@@ -225,8 +299,35 @@ typedef struct snek_list {
 	snek_offset_t	data;
 } snek_list_t;
 
+#ifdef SNEK_STRING_LEN
+/*
+ * Strings carry their length ahead of the text, which is still
+ * NUL-terminated. String values and code refer to the header, while
+ * C code is handed the text
+ */
+typedef struct snek_string {
+	snek_offset_t	len;
+	char		text[];
+} snek_string_t;
+
+#define SNEK_STRING_TEXT	offsetof(snek_string_t, text)
+#else
+#define SNEK_STRING_TEXT	0
+#endif
+
+#ifdef SNEK_STRING_BUILDER
+typedef struct snek_builder {
+	snek_offset_t	alloc;
+	snek_offset_t	len;
+	char		text[];
+} snek_builder_t;
+#endif
+
 typedef struct snek_code {
 	snek_offset_t	size;
+#ifdef SNEK_LINE_TABLE
+	snek_offset_t	lines;		/* bytes of line table after code */
+#endif
 	uint8_t		code[0];
 } snek_code_t;
 
@@ -248,10 +349,19 @@ typedef struct snek_in {
 typedef struct snek_func {
 	uint8_t		nformal;
 	uint8_t		nrequired;
+#ifdef SNEK_LOCAL_SLOTS
+	uint8_t		nlocal;		/* locals follow formals */
+#endif
 	snek_offset_t	code;
 	snek_id_t	formals[0];
 } snek_func_t;
 
+#ifdef SNEK_LOCAL_SLOTS
+#define snek_func_nslot(func)	((func)->nformal + (func)->nlocal)
+#else
+#define snek_func_nslot(func)	((func)->nformal)
+#endif
+
 #define SNEK_FUNC_VARARGS	SNEK_SOFFSET_NONE
 
 typedef struct snek_name {
@@ -259,6 +369,13 @@ typedef struct snek_name {
 	char		name[0];
 } snek_name_t;
 
+#ifdef SNEK_NAME_HASH
+typedef struct snek_name_table {
+	snek_offset_t	nalloc;
+	snek_offset_t	names[0];
+} snek_name_table_t;
+#endif
+
 typedef struct snek_variable {
 	snek_poly_t	value;
 	snek_id_t	id;
@@ -267,8 +384,14 @@ typedef struct snek_variable {
 typedef struct snek_frame {
 	snek_offset_t	prev;
 	snek_offset_t	code;
-	snek_offset_t	ip;
+	union {
+		snek_offset_t	ip;
+		snek_offset_t	nalloc;		/* global frame capacity */
+	};
 	snek_offset_t	nvariables;
+#ifdef SNEK_ID_CACHE
+	snek_offset_t	serial;		/* distinguishes frames at the same offset */
+#endif
 	snek_variable_t	variables[0];
 } snek_frame_t;
 
@@ -336,6 +459,9 @@ extern snek_poly_t	snek_stack[SNEK_STACK];
 extern snek_offset_t	snek_stackp;
 extern snek_poly_t	snek_a;
 extern snek_code_t	*snek_code;
+#ifdef SNEK_LINE_TABLE
+extern snek_offset_t	snek_exec_ip;
+#endif
 
 static inline bool
 snek_is_nan(snek_poly_t p)
@@ -361,12 +487,56 @@ snek_is_global(snek_poly_t p)
 	return p.u == SNEK_GLOBAL_U;
 }
 
+static inline bool
+snek_is_float(snek_poly_t v)
+{
+	if ((v.u & SNEK_EXPONENT_MASK) != SNEK_EXPONENT_MASK || v.u == SNEK_NINF)
+		return true;
+	return false;
+}
+
+
+#ifdef SNEK_ROM
+extern const uint8_t	*snek_rom;
+extern snek_offset_t	snek_rom_size;
+
+/* Objects in the read-only region never move and are never freed */
+static inline bool
+snek_is_rom_addr(const void *addr)
+{
+	return (uintptr_t) addr - (uintptr_t) snek_rom < snek_rom_size;
+}
+
+static inline bool
+snek_offset_is_rom(snek_offset_t offset)
+{
+	return (snek_offset_t) (offset - SNEK_ROM_OFFSET) < snek_rom_size;
+}
+
+static inline void *
+snek_rom_addr(snek_offset_t offset)
+{
+	return (void *) (snek_rom + (offset - SNEK_ROM_OFFSET));
+}
+
+static inline snek_offset_t
+snek_rom_offset(const void *addr)
+{
+	return (snek_offset_t) ((const uint8_t *) addr - snek_rom) + SNEK_ROM_OFFSET;
+}
+#else
+#define snek_is_rom_addr(addr)		((void) (addr), false)
+#define snek_offset_is_rom(offset)	((void) (offset), false)
+#endif
 
 #ifdef SNEK_DYNAMIC
 extern uint8_t *snek_pool  __attribute__((aligned(SNEK_ALLOC_ROUND)));
 extern uint32_t	snek_pool_size;
+extern uint32_t	snek_pool_max;
+#define SNEK_POOL_SIZE	snek_pool_size
 #else
 extern uint8_t	snek_pool[SNEK_POOL] __attribute__((aligned(SNEK_ALLOC_ROUND)));
+#define SNEK_POOL_SIZE	SNEK_POOL
 #endif
 
 #ifndef SNEK_CODE_HOOK_START
@@ -377,6 +547,15 @@ extern uint8_t	snek_pool[SNEK_POOL] __attribute__((aligned(SNEK_ALLOC_ROUND)));
 #define SNEK_CODE_HOOK_STOP
 #endif
 
+/* Run while a collection may be moving objects around */
+#ifndef SNEK_COLLECT_HOOK_START
+#define SNEK_COLLECT_HOOK_START
+#endif
+
+#ifndef SNEK_COLLECT_HOOK_STOP
+#define SNEK_COLLECT_HOOK_STOP
+#endif
+
 #include "snek-gram.h"
 
 typedef union {
@@ -420,6 +599,9 @@ snek_for_tmp(uint8_t for_depth, uint8_t i)
 	return SNEK_OFFSET_NONE - 1 - (for_depth * 2 + i);
 }
 
+uint8_t
+snek_op_operand_size(snek_op_t op);
+
 void
 snek_code_delete_prev(void);
 
@@ -488,6 +670,20 @@ snek_code_patch_branch(snek_offset_t branch, snek_offset_t target)
 	memcpy(snek_compile + branch + 1, &target, sizeof (snek_offset_t));
 }
 
+#ifdef SNEK_FOLD
+bool
+snek_code_constant(snek_offset_t start, snek_offset_t end, float *value);
+
+bool
+snek_code_fold_unop(snek_offset_t start, snek_op_t op);
+
+bool
+snek_code_fold_binop(snek_offset_t left, snek_op_t op);
+
+void
+snek_code_delete(snek_offset_t start, snek_offset_t end);
+#endif
+
 void
 snek_code_reset(void);
 
@@ -497,6 +693,11 @@ snek_code_finish(void);
 snek_offset_t
 snek_code_line(snek_code_t *code);
 
+#ifdef SNEK_LINE_TABLE
+snek_offset_t
+snek_code_line_at(snek_code_t *code, snek_offset_t at);
+#endif
+
 #if defined(DEBUG_COMPILE) || defined(DEBUG_EXEC)
 snek_offset_t
 snek_code_dump_instruction(snek_code_t *code, snek_offset_t ip);
@@ -590,6 +791,13 @@ snek_frame_pop(void);
 snek_poly_t *
 snek_id_ref(snek_id_t id, bool insert);
 
+#ifdef SNEK_ID_CACHE
+snek_poly_t *
+snek_id_ref_ip(snek_id_t id, bool insert, snek_offset_t ip);
+#else
+#define snek_id_ref_ip(id, insert, ip) ((void) (ip), snek_id_ref(id, insert))
+#endif
+
 bool
 snek_id_is_local(snek_id_t id);
 
@@ -620,6 +828,59 @@ snek_func_mark(void *addr);
 void
 snek_func_move(void *addr);
 
+/* snek-image.c */
+
+#ifdef SNEK_IMAGE
+
+/*
+ * A compiled program is saved as this header followed by the
+ * read-only region, if any, and then the heap contents. Objects
+ * refer to each other by offset, so the image loads at any address
+ * without relocation, but only into an interpreter built with the
+ * same configuration. The read-only region is used in place.
+ */
+
+#define SNEK_IMAGE_MAGIC	0x6b6e737fu	/* "\177snk" */
+#define SNEK_IMAGE_VERSION	1
+#define SNEK_IMAGE_NROOT	12
+
+typedef struct snek_image {
+	uint32_t	magic;
+	uint32_t	version;
+	uint32_t	features;	/* configuration affecting object layout */
+	uint32_t	builtin_end;
+	uint32_t	id;		/* last name id allocated */
+	uint32_t	rom;		/* bytes of read-only region */
+	uint32_t	top;		/* bytes of heap following that */
+	uint32_t	nroot;
+	uint32_t	root[SNEK_IMAGE_NROOT];
+} snek_image_t;
+
+extern bool		snek_image_build;
+extern snek_list_t	*snek_image_program;
+
+bool
+snek_image_add(snek_poly_t name, snek_poly_t value);
+
+bool
+snek_image_add_stat(snek_code_t *code);
+
+bool
+snek_image_save(snek_image_t *image);
+
+bool
+snek_image_load(const void *data, uint32_t size);
+
+bool
+snek_image_run(void);
+
+#ifdef SNEK_ROM
+void *
+snek_rom_alloc(snek_offset_t size);
+#endif
+
+#endif
+
 /* snek-lex.c */
 
 extern snek_offset_t snek_line;
@@ -671,6 +932,14 @@ snek_list_del(snek_poly_t lp, snek_poly_t p);
 int8_t
 snek_list_cmp(snek_list_t *a, snek_list_t *b);
 
+#ifdef SNEK_DICT_HASH
+bool
+snek_dict_has(snek_list_t *list, snek_poly_t key);
+
+void
+snek_dict_sort(snek_list_t *list);
+#endif
+
 snek_poly_t
 snek_list_imm(snek_offset_t size, snek_list_type_t type);
 
@@ -696,6 +965,21 @@ snek_list_build(snek_list_type_t type, snek_offset_t size, ...);
 #define SNEK_COLLECT_FULL		0
 #define SNEK_COLLECT_INCREMENTAL	1
 
+
+#ifdef SNEK_GENERATIONAL
+extern snek_offset_t snek_last_top;
+
+void
+snek_remember_offset(snek_offset_t offset);
+#endif
+
+#ifdef SNEK_INCREMENTAL_MARK
+extern bool snek_marking;
+
+void
+snek_mark_barrier(snek_offset_t offset);
+#endif
+
 bool
 snek_is_pool_addr(const void *addr);
 
@@ -735,9 +1019,29 @@ snek_move_addr(const struct snek_mem *type, void **ref);
 bool
 snek_move_offset(const struct snek_mem *type, snek_offset_t *ref);
 
+#ifdef SNEK_DYNAMIC
+bool
+snek_mem_alloc(uint32_t pool_size);
+#endif
+
+#ifdef SNEK_IMAGE
+bool
+snek_mem_image_save(snek_image_t *image);
+
+bool
+snek_mem_image_load(const snek_image_t *image);
+#endif
+
 void *
 snek_alloc(snek_offset_t size);
 
+#ifdef SNEK_FREE_LIST
+void
+snek_free(void *addr, snek_offset_t size);
+#else
+#define snek_free(addr, size)	((void) (addr), (void) (size))
+#endif
+
 void
 snek_stack_push_string(const char *s);
 
@@ -772,6 +1076,8 @@ static inline const struct snek_mem *snek_mems(snek_type_t type)
 
 /* snek-name.c */
 
+extern snek_id_t snek_id;
+
 snek_id_t
 snek_name_id(char *name, bool *keyword);
 
@@ -779,7 +1085,13 @@ const char *
 snek_name_string(snek_id_t id);
 
 extern const snek_mem_t snek_name_mem;
+
+#ifdef SNEK_NAME_HASH
+extern const snek_mem_t snek_name_table_mem;
+extern snek_name_table_t *snek_name_table;
+#else
 extern snek_name_t *snek_names;
+#endif
 
 /* snek-parse.c */
 
@@ -847,6 +1159,18 @@ snek_print(snek_buf_t *buf, snek_poly_t poly);
 
 /* snek-string.c */
 
+#ifdef SNEK_STRING_CHARS
+extern snek_list_t *snek_string_chars;
+#endif
+
+#ifdef SNEK_STRING_BUILDER
+extern snek_builder_t *snek_builder;
+extern const snek_mem_t snek_builder_mem;
+#endif
+
+char *
+snek_string_alloc(snek_offset_t len);
+
 snek_poly_t
 snek_string_make(char c);
 
@@ -858,6 +1182,10 @@ snek_string_build(const char *s);
 snek_poly_t
 snek_string_get(char *string, snek_poly_t p, bool report_error);
 
+char *
+snek_string_catn(char *a, snek_offset_t aoff, snek_offset_t alen,
+		 const char *b, snek_offset_t boff, snek_offset_t blen);
+
 snek_poly_t
 snek_string_cat(char *a, char *b);
 
@@ -924,13 +1252,28 @@ snek_poly_to_list(snek_poly_t poly)
 static inline snek_poly_t
 snek_string_to_poly(char *string)
 {
-	return snek_poly(string, snek_string);
+	if (!string)
+		return SNEK_NULL;
+	return snek_poly(string - SNEK_STRING_TEXT, snek_string);
 }
 
 static inline char *
 snek_poly_to_string(snek_poly_t poly)
 {
-	return snek_ref(poly);
+	if (snek_is_null(poly))
+		return NULL;
+	return (char *) snek_ref(poly) + SNEK_STRING_TEXT;
+}
+
+/* Length of a string value; the text must have come from the heap or code */
+static inline snek_offset_t
+snek_string_len(const char *string)
+{
+#ifdef SNEK_STRING_LEN
+	return ((const snek_string_t *) (string - SNEK_STRING_TEXT))->len;
+#else
+	return (snek_offset_t) strlen(string);
+#endif
 }
 
 static inline snek_func_t *
@@ -1027,6 +1370,28 @@ snek_offset_set_value(snek_offset_t offset, snek_offset_t value)
 	return value | (offset & 3);
 }
 
+/*
+ * Write barrier for stores into lists; old lists are added to the
+ * remembered set so that minor collections find their contents,
+ * and black lists are re-scanned while marking incrementally
+ */
+static inline void
+snek_remember(snek_list_t *list)
+{
+#if defined(SNEK_GENERATIONAL) || defined(SNEK_INCREMENTAL_MARK)
+	snek_offset_t offset = (snek_offset_t) ((uint8_t *) list - snek_pool);
+#endif
+#ifdef SNEK_GENERATIONAL
+	if (offset < snek_last_top)
+		snek_remember_offset(offset);
+#endif
+#ifdef SNEK_INCREMENTAL_MARK
+	if (snek_marking)
+		snek_mark_barrier(offset);
+#endif
+	(void) list;
+}
+
 static inline bool
 snek_list_readonly(snek_list_t *list)
 {
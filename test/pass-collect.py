@@ -0,0 +1,43 @@
+#
+# Copyright © 2026 agent <agent@local>
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# General Public License for more details.
+#
+
+
+#
+# Churn through short-lived strings while storing them into lists
+# and dicts which have survived earlier collections
+#
+
+old = [0] * 50
+nest = [[0], [0], [0]]
+d = {}
+
+for i in range(5000):
+    s = "v%d" % i
+    old[i % 50] = s + "!"
+    nest[i % 3][0] = [s]
+    d[i % 7] = s
+    d["k%d" % (i % 100)] = s
+
+assert old[49] == "v4999!"
+assert old[0] == "v4950!"
+assert nest[1][0] == ["v4999"]
+assert d[3] == "v4994"
+assert d["k34"] == "v4934"
+assert len(d) == 107
+
+t = []
+for i in range(300):
+    t += ["%d" % i]
+assert t[299] == "299"
+assert len(t) == 300
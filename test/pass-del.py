@@ -0,0 +1,58 @@
+#
+# Copyright © 2026 agent <agent@local>
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# General Public License for more details.
+#
+
+#
+# Make sure deleting globals leaves the others intact, and that the
+# global frame keeps working as it grows
+#
+
+a = 1
+b = 2
+c = 3
+del a
+assert b == 2
+assert c == 3
+
+g0 = 0
+g1 = 1
+g2 = 2
+g3 = 3
+g4 = 4
+g5 = 5
+g6 = 6
+g7 = 7
+g8 = 8
+g9 = 9
+g10 = 10
+g11 = 11
+g12 = 12
+g13 = 13
+g14 = 14
+g15 = 15
+g16 = 16
+g17 = 17
+
+del g5
+del b
+del g17
+
+assert g0 + g1 + g2 + g3 + g4 + g6 + g7 + g8 == 31
+assert g9 + g10 + g11 + g12 + g13 + g14 + g15 + g16 == 100
+assert c == 3
+
+g5 = "five"
+b = "bee"
+assert g5 == "five"
+assert b == "bee"
+assert g4 == 4 and g6 == 6
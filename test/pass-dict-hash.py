@@ -0,0 +1,66 @@
+#
+# Copyright © 2026 agent <agent@local>
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# General Public License for more details.
+#
+
+
+#
+# Check dict lookup with many keys of mixed types, including keys
+# which are equal but not identical
+#
+
+d = {}
+for i in range(200):
+    d[i] = i * 2
+    d["s%d" % i] = i
+    d[(i, "t")] = -i
+
+assert len(d) == 600
+for i in range(200):
+    assert d[i] == i * 2
+    assert d["s%d" % i] == i
+    assert d[(i, "t")] == -i
+    assert i in d
+    assert (i, "t") in d
+    assert (i, "u") not in d
+
+assert 200 not in d
+assert d[1.0] == 2
+assert d[(2.0, "t")] == -2
+
+d[-0.0] = "zero"
+assert d[0] == "zero"
+
+for i in range(0, 200, 2):
+    del d[i]
+    del d["s%d" % i]
+
+assert len(d) == 400
+for i in range(200):
+    assert (i in d) == (i % 2 == 1)
+    assert ("s%d" % i in d) == (i % 2 == 1)
+    assert d[(i, "t")] == -i
+
+e = {}
+for k in d:
+    e[k] = d[k]
+assert e == d
+
+f = {}
+for i in range(199, -1, -1):
+    f[(i, "t")] = -i
+for i in range(1, 200, 2):
+    f["s%d" % i] = i
+    f[i] = i * 2
+assert f == d
+f[1] = 3
+assert f != d
@@ -0,0 +1,57 @@
+#
+# Copyright © 2026 agent <agent@local>
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# General Public License for more details.
+#
+
+
+#
+# Snek keeps dicts sorted by key, so equal dicts print the same
+# whatever order their keys were added in, and dicts are ordered by
+# their sorted contents. Python keeps insertion order instead, so
+# this only runs on snek
+#
+
+a = {"b": 1, "a": 2}
+b = {"a": 2, "b": 1}
+assert a == b
+assert "%r" % (a,) == "{'a': 2, 'b': 1}"
+assert "%r" % (a,) == "%r" % (b,)
+
+c = {}
+for i in range(20, 0, -1):
+    c[i] = i * i
+d = {}
+for i in range(1, 21):
+    d[i] = i * i
+assert c == d
+assert "%r" % (c,) == "%r" % (d,)
+del c[7]
+del d[7]
+c[7] = 1
+d[7] = 1
+assert c == d
+assert "%r" % (c,) == "%r" % (d,)
+
+keys = []
+for k in {3: 0, 1: 0, 2: 0}:
+    keys += [k]
+assert keys == [1, 2, 3]
+
+keys = []
+for k in c:
+    keys += [k]
+for i in range(20):
+    assert keys[i] == i + 1
+
+assert {"a": 1} < {"b": 1}
+assert {"b": 1} > {"a": 1}
+assert {1: 2} < {1: 3}
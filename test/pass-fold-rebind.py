@@ -0,0 +1,41 @@
+#
+# Copyright © 2026 agent <agent@local>
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# General Public License for more details.
+#
+
+#
+# True and False are names in snek and may be rebound, so the
+# compiler must not fold them as constants
+#
+
+True = 0
+False = 1
+
+assert True + 1 == 1
+assert not True
+
+r = 0
+if True:
+    r = 1
+else:
+    r = 2
+assert r == 2
+
+if False:
+    r += 10
+assert r == 12
+
+if not False:
+    r += 100
+else:
+    r += 200
+assert r == 212
@@ -0,0 +1,112 @@
+#
+# Copyright © 2026 agent <agent@local>
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# General Public License for more details.
+#
+
+#
+# Check that constant expressions evaluated by the compiler match the
+# same expressions evaluated at run time, and that if statements with
+# constant conditions run the right code
+#
+
+import math
+
+one = 1
+two = 2
+three = 3
+
+assert 2 * math.pi / 360 == two * math.pi / 360
+assert 1 + 2 * 3 == one + two * three
+assert (1 + 2) * 3 == (one + two) * three
+assert 7 - 2 - 1 == 7 - two - one
+assert 2**3**2 == two**three**two
+assert -7 // 2 == -7 // two
+assert -7 % 3 == -7 % three
+assert 7 / 2 == 7 / two
+assert 1 << 4 == one << 4
+assert 256 >> 3 == 256 >> three
+assert 255 & 15 | 256 ^ 3 == 255 & 15 | 256 ^ three
+assert ~5 == ~(two + three)
+assert -(2 + 3) == -(two + three)
+assert not True == (not (one == 1))
+assert 1000 * 1000 == 1000000
+assert [1, 2][2 - 1] == 2
+assert 10 > 2 + 3 > 4
+
+x = [0, 0, 0]
+x[1 + 1] = 5
+assert x == [0, 0, 5]
+
+
+def cond(a):
+    r = 0
+    if False:
+        r = 1
+    elif a:
+        r = 2
+    else:
+        r = 3
+    if True:
+        r += 10
+    else:
+        r += 20
+    if 1 - 1:
+        r += 100
+    if not 0:
+        r += 1000
+    elif a:
+        r += 2000
+    return r
+
+
+assert cond(0) == 1013
+assert cond(1) == 1012
+
+
+def loop(n):
+    r = 0
+    for i in range(n):
+        if False:
+            break
+        elif i == 2:
+            continue
+        if True:
+            r += i
+    while True:
+        if True:
+            break
+        r = -1
+    return r
+
+
+assert loop(5) == 8
+
+
+def ret(a):
+    if True:
+        return a * 2
+    else:
+        return a * 3
+
+
+assert ret(4) == 8
+
+# Builtin values other than True and False may be rebound, so they
+# must not be folded
+math.pi = 3
+assert math.pi * 2 == 6
+r = 0
+if math.pi > 3.1:
+    r = 1
+else:
+    r = 2
+assert r == 2
@@ -18,3 +18,71 @@ for i in range(1, 10, 1):
 
 if product != 362880:
     exit(1)
+
+# Assigning to the loop variable doesn't change the sequence
+seen = []
+for i in range(1, 12, 3):
+    seen += [i]
+    i = 100
+if seen != [1, 4, 7, 10]:
+    print("fail reassign %s" % (seen,))
+    exit(1)
+
+seen = []
+for i in range(7, -3, -4):
+    seen += [i]
+if seen != [7, 3, -1] or i != -1:
+    print("fail negative %s" % (seen,))
+    exit(1)
+
+
+def first_over(n, limit):
+    for j in range(n):
+        for k in range(j):
+            if j * k > limit:
+                return (j, k)
+    return None
+
+
+for r in range(500):
+    if first_over(10, 20) != (6, 4) or first_over(3, 20) is not None:
+        print("fail return from nested range")
+        exit(1)
+
+total = 0
+for i in range(1000):
+    total += i
+if total != 499500 or i != 999:
+    print("fail long range %d %d" % (total, i))
+    exit(1)
+
+
+# Leaving loops early must not disturb the enclosing loops
+def leave(n):
+    seen = []
+    for j in range(n):
+        for k in range(n):
+            if k > j:
+                break
+            seen += [k]
+        else:
+            seen += [-1]
+        w = 0
+        while True:
+            for k in range(3):
+                w += 1
+            if w > 5:
+                break
+        for k in range(2):
+            pass
+        else:
+            if j == 2:
+                break
+        seen += [w]
+    return seen
+
+
+for r in range(50):
+    if leave(4) != [0, 6, 0, 1, 6, 0, 1, 2]:
+        print("fail leave %s" % (leave(4),))
+        exit(1)
@@ -0,0 +1,103 @@
+#
+# Copyright © 2026 agent <agent@local>
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# General Public License for more details.
+#
+
+#
+# Check instruction sequences which may be combined into
+# superinstructions, including ones where a branch lands between
+# the two instructions
+#
+
+
+def imm(x):
+    return (x + 1, x - 2, x * 3, x == 4, x != 4, x > 4, x < 4, x >= 4, x <= 4)
+
+
+assert imm(4) == (5, 2, 12, True, False, False, False, True, True)
+assert imm(-7) == (-6, -9, -21, False, True, False, True, False, True)
+assert imm(2.5) == (3.5, 0.5, 7.5, False, True, False, True, False, True)
+assert imm("a" == "a") == (2, -1, 3, False, True, False, True, False, True)
+assert "x" * 3 == "xxx"
+assert "s" != 1
+
+
+def join(x, c):
+    return (x + (c and 2), x - (c or 2))
+
+
+assert join(3, 1) == (5, 2)
+assert join(3, 0) == (3, 1)
+
+
+def pick(x, c):
+    if x < (c or 10):
+        return "lt"
+    return "ge"
+
+
+assert pick(5, 1) == "ge"
+assert pick(5, 0) == "lt"
+
+
+def logic(a, b):
+    r = 0
+    if a > 1 and b < 2:
+        r += 1
+    if a == 1 or b != 2:
+        r += 10
+    if not a >= 3:
+        r += 100
+    if 0 < a < 5:
+        r += 1000
+    return r
+
+
+assert logic(2, 1) == 1 + 10 + 100 + 1000
+assert logic(1, 2) == 10 + 100 + 1000
+assert logic(7, 2) == 0
+assert logic(3, 5) == 10 + 1000
+
+t = 0
+i = 0
+while i < 20:
+    i += 1
+    if i % 2 == 0:
+        continue
+    if i > 15:
+        break
+    for j in range(i):
+        if j >= 3:
+            break
+        t += j
+assert t == 21
+
+v = 3 > 2
+assert v == True
+
+s = "abc"
+assert (s == "abc") == True
+assert ("abc" < "abd") == True
+
+d = {1: 2, 3: 4, 5: 6}
+assert d[5] == 6 and len(d) == 3
+
+
+def dicts(a):
+    e = {a: 1, a + 1: 2, a + 2: 3, a + 3: 4}
+    if a > 0:
+        return e[a + 3]
+    return len(e)
+
+
+assert dicts(1) == 4
+assert dicts(0) == 4
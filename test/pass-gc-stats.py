@@ -0,0 +1,53 @@
+#
+# Copyright © 2026 agent <agent@local>
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# General Public License for more details.
+#
+
+
+#
+# Check the dictionary returned by gc.stats(), which only the posix
+# port provides
+#
+
+keys = [
+    "allocated",
+    "full",
+    "heap",
+    "incremental",
+    "live",
+    "overflow",
+    "pause",
+    "pause_max",
+    "used",
+]
+types = ["code", "frame", "func", "list", "name", "string"]
+
+junk = []
+for i in range(2000):
+    junk = [i, "s%d" % i]
+
+s = gc.stats()
+assert len(s) == len(keys)
+for k in keys:
+    assert k in s
+    if k != "live":
+        assert s[k] >= 0
+
+live = s["live"]
+assert len(live) == len(types)
+for t in types:
+    assert t in live
+    assert live[t] >= 0
+
+assert s["allocated"] > 0
+assert s["used"] <= s["heap"]
+assert s["pause"] >= s["pause_max"]
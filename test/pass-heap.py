@@ -0,0 +1,32 @@
+#
+# Copyright © 2026 agent <agent@local>
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# General Public License for more details.
+#
+
+
+#
+# Keep more data alive than fits in the initial heap
+#
+
+strings = []
+for i in range(40000):
+    strings += ["s%d" % i]
+
+numbers = [0] * 100000
+for i in range(0, 100000, 7):
+    numbers[i] = i
+
+assert len(strings) == 40000
+assert strings[0] == "s0"
+assert strings[39999] == "s39999"
+assert numbers[99995] == 99995
+assert numbers[99999] == 0
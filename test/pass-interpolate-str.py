@@ -27,3 +27,4 @@ assert ("%d" + "x" * 300 + "%d") % (
     34,
 ) == "12xxxxxxxxxx" + "xx" * 140 + "xxxxxxxxxx34"
 assert "%r" % {1: "hello", 2: "world"} == "{1: 'hello', 2: 'world'}"
+assert "" % () == ""
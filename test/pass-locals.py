@@ -0,0 +1,69 @@
+#
+# Copyright © 2026 agent <agent@local>
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# General Public License for more details.
+#
+
+#
+# Exercise function locals mixed with formals, defaults, loops,
+# globals and recursion
+#
+
+x = 10
+y = 20
+
+
+def f(a, b=2, c=3):
+    t = a + b
+    for i in range(3):
+        t += i
+    for j in (1, 2):
+        t += j
+    u = t * c
+    return u + y
+
+
+assert f(1) == 47
+assert f(1, c=10) == 110
+assert f(a=2, b=0) == 44
+assert f(c=1, a=0, b=0) == 26
+
+
+def g():
+    global x
+    x = 3
+    z = x + y
+    return z
+
+
+assert g() == 23
+assert x == 3
+
+
+def h(n):
+    if n == 0:
+        return 0
+    q = n
+    r = h(n - 1)
+    return q + r
+
+
+assert h(10) == 55
+
+
+def k(a, b):
+    t = a
+    a = b
+    b = t
+    return a - b
+
+
+assert k(1, 2) == 1
@@ -0,0 +1,77 @@
+#
+# Copyright © 2026 agent <agent@local>
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# General Public License for more details.
+#
+
+#
+# Run binary operators with float operands until they are
+# rewritten to float-only forms, then pass other types to
+# the same instructions
+#
+
+
+def add(a, b):
+    return a + b
+
+
+def sub(a, b):
+    return a - b
+
+
+def mul(a, b):
+    return a * b
+
+
+def divide(a, b):
+    return a / b
+
+
+def compare(a, b):
+    return (a == b, a != b, a > b, a < b, a >= b, a <= b)
+
+
+for i in range(10):
+    assert add(i, 2.5) == i + 2.5
+    assert sub(i, 2.5) == i - 2.5
+    assert mul(i, 2.5) == i * 2.5
+    assert divide(i, 4) == i / 4
+    assert compare(i, 5) == (i == 5, i != 5, i > 5, i < 5, i >= 5, i <= 5)
+
+assert add("ab", "cd") == "abcd"
+assert add([1], [2]) == [1, 2]
+assert add((1,), (2,)) == (1, 2)
+assert mul("x", 3) == "xxx"
+assert divide(7, 2) == 3.5
+
+assert compare("a", "b") == (False, True, False, True, False, True)
+assert compare([1, 2], [1, 2]) == (True, False, False, False, True, True)
+assert compare((2,), (1,)) == (False, True, True, False, True, False)
+
+def equal(a, b):
+    return a == b
+
+
+for i in range(5):
+    assert equal(i, 3) == (i == 3)
+assert equal(1, "a") is False
+assert equal("a", "a") is True
+
+for i in range(10):
+    assert (add(i, i), sub(i, i), mul(i, i)) == (i + i, 0, i * i)
+    assert compare(i, i) == (True, False, False, False, True, True)
+
+t = 0
+x = 1.5
+while x < 1000:
+    t += x
+    x = x * 2 - 1
+assert t == 1.5 + 2 + 3 + 5 + 9 + 17 + 33 + 65 + 129 + 257 + 513
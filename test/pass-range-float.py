@@ -0,0 +1,34 @@
+#
+# Copyright © 2026 agent <agent@local>
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# General Public License for more details.
+#
+
+
+#
+# Range loops with a fractional step compute each value as
+# start + index * step. Python's range only takes integers, so this
+# only runs on snek
+#
+
+v = []
+for x in range(0, 1, 0.1):
+    v += [x]
+assert len(v) == 10
+assert v[0] == 0
+assert v[1] == 0.1
+for i in range(10):
+    assert v[i] == i * 0.1
+
+v = []
+for x in range(2, 0.9, -0.25):
+    v += [x]
+assert v == [2, 1.75, 1.5, 1.25, 1]